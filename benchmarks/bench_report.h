@@ -0,0 +1,150 @@
+/**
+ * @file bench_report.h
+ * @brief Shared timing and reporting helpers for the benchmark executables
+ *
+ * Every benchmark emits flat records (benchmark, params, threads, value,
+ * unit) so results from different versions can be diffed by a script.
+ *
+ * Command line:
+ *   --format json|csv   output format, json by default
+ *   --filter TEXT       only run benchmarks whose name contains TEXT
+ *   --quick             shrink iteration counts for smoke runs
+ *   --out FILE          write results to FILE instead of stdout
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef EDC_VERSION
+#define EDC_VERSION "unknown"
+#endif
+
+struct Bench_Record {
+    std::string benchmark;
+    std::string params;
+    int threads;
+    double value;
+    std::string unit;
+};
+
+class Bench_Report {
+public:
+    Bench_Report(const char *suite, int argc, char **argv) : m_suite(suite)
+    {
+        for (int i = 1; i < argc; i++) {
+            if (!strcmp(argv[i], "--format") && i + 1 < argc) m_csv = !strcmp(argv[++i], "csv");
+            else if (!strcmp(argv[i], "--filter") && i + 1 < argc) m_filter = argv[++i];
+            else if (!strcmp(argv[i], "--out") && i + 1 < argc) m_out_path = argv[++i];
+            else if (!strcmp(argv[i], "--quick")) m_quick = true;
+        }
+    }
+
+    bool enabled(const char *benchmark) const
+    {
+        return m_filter.empty() || std::string(benchmark).find(m_filter) != std::string::npos;
+    }
+
+    // scales an iteration count down for --quick runs
+    size_t iterations(size_t full) const { return m_quick ? (full / 20 > 0 ? full / 20 : 1) : full; }
+
+    void add(const std::string &benchmark, const std::string &params, int threads, double value, const char *unit)
+    {
+        m_records.push_back({benchmark, params, threads, value, unit});
+        fprintf(stderr, "%-28s %-24s threads=%-3d %14.3f %s\n", benchmark.c_str(), params.c_str(), threads, value, unit);
+    }
+
+    // writes every record, returns the process exit code
+    int finish() const
+    {
+        FILE *out = m_out_path.empty() ? stdout : fopen(m_out_path.c_str(), "w");
+        if (!out) return 1;
+        if (m_csv) {
+            fprintf(out, "suite,version,benchmark,params,threads,value,unit\n");
+            for (const Bench_Record &r : m_records) {
+                fprintf(out, "%s,%s,%s,%s,%d,%.6f,%s\n", csv_field(m_suite).c_str(), csv_field(EDC_VERSION).c_str(),
+                        csv_field(r.benchmark).c_str(), csv_field(r.params).c_str(), r.threads, r.value,
+                        csv_field(r.unit).c_str());
+            }
+        } else {
+            fprintf(out, "{\"suite\":%s,\"version\":%s,\"results\":[", json_string(m_suite).c_str(),
+                    json_string(EDC_VERSION).c_str());
+            for (size_t i = 0; i < m_records.size(); i++) {
+                const Bench_Record &r = m_records[i];
+                fprintf(out, "%s\n  {\"benchmark\":%s,\"params\":%s,\"threads\":%d,\"value\":%.6f,\"unit\":%s}",
+                        i ? "," : "", json_string(r.benchmark).c_str(), json_string(r.params).c_str(), r.threads,
+                        r.value, json_string(r.unit).c_str());
+            }
+            fprintf(out, "\n]}\n");
+        }
+        if (out != stdout) fclose(out);
+        return 0;
+    }
+
+private:
+    // RFC 4180: quoted when it holds a separator, quote or line break, quotes doubled
+    static std::string csv_field(const std::string &field)
+    {
+        if (field.find_first_of(",\"\r\n") == std::string::npos) return field;
+        std::string quoted = "\"";
+        for (char c : field) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    static std::string json_string(const std::string &text)
+    {
+        std::string escaped = "\"";
+        for (unsigned char c : text) {
+            switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += (char)c;
+                }
+            }
+        }
+        return escaped + "\"";
+    }
+
+    std::string m_suite;
+    std::string m_filter;
+    std::string m_out_path;
+    bool m_csv = false;
+    bool m_quick = false;
+    std::vector<Bench_Record> m_records;
+};
+
+class Bench_Timer {
+public:
+    Bench_Timer() : m_start(std::chrono::steady_clock::now()) {}
+    double elapsed_ns() const
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// keeps the optimizer from discarding a computed value
+inline void bench_keep(uintptr_t value)
+{
+    static volatile uintptr_t sink;
+    sink = sink ^ value;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file dc_batch_check.cpp
+ * @brief Golden-image check that Display_List::batch() keeps the pixels
+ *
+ * Batching moves rects past the commands between them, so a wrong overlap
+ * test shows up as a changed pixel. Random scenes of translucent rects with
+ * fractional edges and a few bounded call components are rasterized once as
+ * recorded and once batched, in full and through a damage clip, and the two
+ * images must be identical. The scenes come from a fixed seed, so a failure
+ * reproduces by its scene number.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "dc_display_list.h"
+#include "dc_software_raster.h"
+
+static const int check_scenes = 300;
+static const int check_rects = 40;
+static const int check_size = 128;
+
+// a call component whose CPU fallback fills its rect, so moving a rect
+// across it changes pixels
+struct Check_Call {
+    Draw_Rect rect;
+    Draw_Color color;
+};
+
+static void check_draw_call(void *data, Draw_Context *context)
+{
+    const Check_Call *call = static_cast<const Check_Call*>(data);
+    context->fill_rect(call->rect, call->color);
+}
+
+static void check_draw_call_cpu(void *data, Software_Draw_Context &context)
+{
+    check_draw_call(data, &context);
+}
+
+// few colors, so that batches form, and translucent ones, so that order shows
+static Draw_Color check_color(std::mt19937 &random)
+{
+    static const Draw_Color palette[] = {
+        {1.0f, 0.0f, 0.0f, 0.5f}, {0.0f, 0.8f, 0.2f, 0.7f}, {0.1f, 0.2f, 1.0f, 1.0f}, {1.0f, 1.0f, 0.0f, 0.3f},
+    };
+    return palette[random() % (sizeof(palette) / sizeof(palette[0]))];
+}
+
+static Draw_Rect check_rect(std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> position(-8.0f, check_size), extent(0.5f, 40.0f);
+    float x = position(random), y = position(random);
+    return {x, y, x + extent(random), y + extent(random)};
+}
+
+static Raster_Image check_render(const Display_List &list, const Draw_Rect &clip)
+{
+    Raster_Image image(check_size, check_size);
+    image.clear(0xFF202020);
+    Software_Draw_Context context(image, clip);
+    context.set_call_fallback(reinterpret_cast<void*>(&check_draw_call), check_draw_call_cpu);
+    list.replay(context, clip);
+    return image;
+}
+
+// 0 when equal, otherwise reports the first differing pixel
+static int check_compare(const Raster_Image &expected, const Raster_Image &actual, int scene, const char *pass)
+{
+    for (int y = 0; y < check_size; y++) {
+        for (int x = 0; x < check_size; x++) {
+            if (expected.pixel(x, y) == actual.pixel(x, y)) continue;
+            std::printf("scene %d (%s): pixel %d,%d is %08X batched, %08X as recorded\n",
+                        scene, pass, x, y, actual.pixel(x, y), expected.pixel(x, y));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main()
+{
+    std::mt19937 random(20240517);
+    std::vector<Check_Call> calls(check_rects);
+    size_t draw_calls_before = 0, draw_calls_after = 0;
+    int failures = 0;
+    for (int scene = 0; scene < check_scenes; scene++) {
+        Display_List list, batched;
+        for (int i = 0; i < check_rects; i++) {
+            if (random() % 10 == 0) {
+                calls[i] = {check_rect(random), check_color(random)};
+                list.call(reinterpret_cast<void*>(&check_draw_call), &calls[i], calls[i].rect);
+            }
+            else {
+                list.fill_rect(check_rect(random), check_color(random));
+            }
+        }
+        Display_List_Batch_Stats stats = batched.batch(list);
+        draw_calls_before += stats.draw_calls_before;
+        draw_calls_after += stats.draw_calls_after;
+
+        failures += check_compare(check_render(list, draw_rect_unbounded), check_render(batched, draw_rect_unbounded),
+                                  scene, "full");
+        Draw_Rect damage = check_rect(random);
+        failures += check_compare(check_render(list, damage), check_render(batched, damage), scene, "clipped");
+    }
+    std::printf("%d scenes, %zu draw calls batched into %zu, simd=%s: %s\n", check_scenes, draw_calls_before,
+                draw_calls_after, Software_Draw_Context::simd_name(), failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+/**
+ * @file dc_display_list_bench.cpp
+ * @brief Replay cost of display lists against walking the component map,
+ * the cost and payoff of damage tracking, the brush cache's hit rate and
+ * lookup cost, the software rasterizer's fill rate, and what batching
+ * same-color rects saves in draw calls
+ *
+ * Both replay sides draw into a Recording_Draw_Context and the cache runs
+ * over a mock factory, so the numbers are the per-frame overhead of getting
+ * commands and resources to a backend, without a GPU.
+ */
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_report.h"
+#include "dc_display_list.h"
+#include "dc_resource_cache.h"
+#include "dc_software_raster.h"
+
+// a rect component the way DC_Surface_Helper::addRect() stores one: a map
+// holding the data and a pointer to the function that draws it
+struct Bench_Rect {
+    float x, y, width, height;
+    Draw_Color color;
+};
+
+typedef void (*Bench_Draw_Function)(void *data, Draw_Context *context);
+
+static void bench_draw_rect(void *data, Draw_Context *context)
+{
+    const Bench_Rect *rect = static_cast<const Bench_Rect *>(data);
+    context->fill_rect({rect->x, rect->y, rect->x + rect->width, rect->y + rect->height}, rect->color);
+}
+
+typedef std::unordered_map<std::string, void *> Bench_Component;
+
+static void bench_replay(Bench_Report &report)
+{
+    if (!report.enabled("display_list")) return;
+    for (size_t count : {16, 256, 4096}) {
+        std::vector<Bench_Rect> rects(count);
+        std::unordered_map<std::string, Bench_Component> components;
+        for (size_t i = 0; i < count; i++) {
+            float f = static_cast<float>(i);
+            rects[i] = {f, f, 10.0f, 10.0f, {f / count, 0.5f, 0.25f, 1.0f}};
+            components["rect_" + std::to_string(i)] = {
+                {"data", &rects[i]},
+                {"draw_func", reinterpret_cast<void *>(&bench_draw_rect)},
+            };
+        }
+        Recording_Draw_Context recorder;
+        size_t frames = report.iterations(20000000) / count;
+        std::string params = "components=" + std::to_string(count);
+
+        Bench_Timer walk_timer;
+        for (size_t frame = 0; frame < frames; frame++) {
+            recorder.clear();
+            for (auto &pair : components) {
+                auto draw_func = reinterpret_cast<Bench_Draw_Function>(pair.second.find("draw_func")->second);
+                draw_func(pair.second.find("data")->second, &recorder);
+            }
+        }
+        report.add("display_list_replay", params + ",source=map_walk", 1,
+                   walk_timer.elapsed_ns() / (frames * count), "ns/component");
+        bench_keep(recorder.commands().size());
+
+        Display_List list;
+        Bench_Timer build_timer;
+        size_t builds = frames / 8 + 1;
+        for (size_t build = 0; build < builds; build++) {
+            list.clear();
+            for (auto &pair : components) {
+                const Bench_Rect *rect = static_cast<const Bench_Rect *>(pair.second.find("data")->second);
+                list.fill_rect({rect->x, rect->y, rect->x + rect->width, rect->y + rect->height}, rect->color);
+            }
+        }
+        report.add("display_list_build", params, 1, build_timer.elapsed_ns() / (builds * count), "ns/component");
+
+        Bench_Timer replay_timer;
+        for (size_t frame = 0; frame < frames; frame++) {
+            recorder.clear();
+            list.replay(recorder);
+        }
+        report.add("display_list_replay", params + ",source=display_list", 1,
+                   replay_timer.elapsed_ns() / (frames * count), "ns/component");
+        report.add("display_list_bytes", params, 1, static_cast<double>(list.size_bytes()) / count, "bytes/component");
+        bench_keep(recorder.commands().size());
+    }
+}
+
+static void bench_damage(Bench_Report &report)
+{
+    if (!report.enabled("damage")) return;
+    // a 4K surface tiled with 10x10 rects, one of which moves every frame
+    const float surface_width = 3840.0f, surface_height = 2160.0f;
+    const Draw_Rect surface = {0.0f, 0.0f, surface_width, surface_height};
+    for (size_t count : {256, 4096}) {
+        std::vector<Draw_Rect> rects(count);
+        size_t columns = static_cast<size_t>(surface_width / 20.0f);
+        for (size_t i = 0; i < count; i++) {
+            float x = static_cast<float>(i % columns) * 20.0f, y = static_cast<float>(i / columns) * 20.0f;
+            rects[i] = {x, y, x + 10.0f, y + 10.0f};
+        }
+        Display_List drawn, list;
+        for (const Draw_Rect &rect : rects) drawn.fill_rect(rect, {1.0f, 0.0f, 0.0f, 1.0f});
+        Recording_Draw_Context recorder;
+        size_t frames = report.iterations(2000000) / count + 1;
+        std::string params = "components=" + std::to_string(count) + ",surface=3840x2160";
+
+        double pixels = 0.0;
+        size_t replayed = 0;
+        Bench_Timer timer;
+        for (size_t frame = 0; frame < frames; frame++) {
+            Draw_Rect &moved = rects[(frame * 7919) % count];
+            float step = (frame & 1) ? -1.0f : 1.0f;
+            moved = {moved.left + step, moved.top, moved.right + step, moved.bottom};
+            list.clear();
+            for (const Draw_Rect &rect : rects) list.fill_rect(rect, {1.0f, 0.0f, 0.0f, 1.0f});
+            Draw_Rect damage = draw_rect_intersection(list.damage_since(drawn), surface);
+            recorder.clear();
+            if (!draw_rect_is_empty(damage)) {
+                replayed += list.replay(recorder, damage);
+                pixels += static_cast<double>(damage.right - damage.left) * (damage.bottom - damage.top);
+            }
+            std::swap(drawn, list);
+        }
+        double elapsed = timer.elapsed_ns();
+        report.add("damage_frame", params, 1, elapsed / frames, "ns/frame");
+        report.add("damage_pixels_redrawn", params, 1, 100.0 * pixels / (frames * surface_width * surface_height), "%");
+        report.add("damage_commands_replayed", params, 1, static_cast<double>(replayed) / frames, "commands/frame");
+        bench_keep(recorder.commands().size());
+    }
+}
+
+// hands out distinct dummy pointers and counts what is still alive
+class Mock_Resource_Factory : public Draw_Resource_Factory {
+public:
+    void *create(const Draw_Resource_Desc &) override
+    {
+        live++;
+        return reinterpret_cast<void *>(++next);
+    }
+    void release(void *) override { live--; }
+
+    uintptr_t next = 0;
+    size_t live = 0;
+};
+
+static void bench_resource_cache(Bench_Report &report)
+{
+    if (!report.enabled("resource_cache")) return;
+    // a frame of 1024 rects cycling through a palette, against caches smaller and larger than it
+    const size_t rects_per_frame = 1024;
+    for (size_t palette : {16, 256, 1024}) {
+        for (size_t capacity : {64, 512}) {
+            Mock_Resource_Factory factory;
+            Draw_Resource_Cache cache(factory, capacity);
+            std::vector<Draw_Resource_Desc> descs;
+            for (size_t i = 0; i < rects_per_frame; i++) {
+                float shade = static_cast<float>(i % palette) / palette;
+                descs.push_back(Draw_Resource_Desc::solid_brush({shade, 1.0f - shade, 0.5f, 1.0f}));
+            }
+            size_t frames = report.iterations(20000000) / rects_per_frame;
+            uintptr_t acc = 0;
+            Bench_Timer timer;
+            for (size_t frame = 0; frame < frames; frame++) {
+                for (const Draw_Resource_Desc &desc : descs) acc += reinterpret_cast<uintptr_t>(cache.get(desc));
+            }
+            double elapsed = timer.elapsed_ns();
+            Draw_Resource_Stats stats = cache.stats();
+            std::string params = "palette=" + std::to_string(palette) + ",capacity=" + std::to_string(capacity);
+            report.add("resource_cache_get", params, 1, elapsed / (frames * rects_per_frame), "ns/get");
+            report.add("resource_cache_hit_rate", params, 1, 100.0 * stats.hits / (stats.hits + stats.misses), "%");
+            report.add("resource_cache_evictions", params, 1, static_cast<double>(stats.evictions) / frames, "evictions/frame");
+            bench_keep(acc + factory.live);
+        }
+    }
+}
+
+static void bench_raster(Bench_Report &report)
+{
+    if (!report.enabled("raster")) return;
+    // a 1080p frame of 64x64 rects at fractional positions, so every rect has antialiased edges
+    Raster_Image image(1920, 1080);
+    const size_t rects_per_frame = 512;
+    for (float alpha : {1.0f, 0.5f}) {
+        Display_List list;
+        for (size_t i = 0; i < rects_per_frame; i++) {
+            float x = static_cast<float>((i * 37) % 1856) + 0.25f, y = static_cast<float>((i * 53) % 1016) + 0.5f;
+            list.fill_rect({x, y, x + 64.0f, y + 64.0f}, {0.2f, 0.4f, 0.8f, alpha});
+        }
+        size_t frames = report.iterations(20000000) / (rects_per_frame * 4096) + 1;
+        Software_Draw_Context context(image);
+        // blending over the last frame costs the same as over a cleared one
+        image.clear();
+        Bench_Timer timer;
+        for (size_t frame = 0; frame < frames; frame++) list.replay(context);
+        double elapsed = timer.elapsed_ns();
+        std::string params = std::string("simd=") + Software_Draw_Context::simd_name() +
+            (alpha < 1.0f ? ",fill=translucent" : ",fill=opaque");
+        report.add("raster_fill_rate", params, 1, context.pixels_blended() * 1e3 / elapsed, "Mpixel/s");
+        report.add("raster_frame", params + ",rects=512", 1, elapsed / frames, "ns/frame");
+        bench_keep(image.pixel(100, 100));
+    }
+}
+
+static void bench_batching(Bench_Report &report)
+{
+    if (!report.enabled("batching")) return;
+    // a dense dashboard: a grid of 8x8 cells, each color repeating every few cells
+    Raster_Image image(1920, 1080);
+    for (size_t colors : {4, 16}) {
+        Display_List list, batched;
+        for (size_t i = 0; i < 10000; i++) {
+            float x = static_cast<float>(i % 200) * 9.0f, y = static_cast<float>(i / 200) * 9.0f;
+            float shade = static_cast<float>(i % colors) / colors;
+            list.fill_rect({x, y, x + 8.0f, y + 8.0f}, {shade, 0.5f, 1.0f - shade, 1.0f});
+        }
+        size_t builds = report.iterations(2000000) / 10000 + 1;
+        Display_List_Batch_Stats stats = {};
+        Bench_Timer build_timer;
+        for (size_t build = 0; build < builds; build++) stats = batched.batch(list);
+        std::string params = "rects=10000,colors=" + std::to_string(colors);
+        report.add("batching_build", params, 1, build_timer.elapsed_ns() / (builds * stats.rects), "ns/rect");
+        report.add("batching_draw_calls", params + ",stage=before", 1, static_cast<double>(stats.draw_calls_before), "calls");
+        report.add("batching_draw_calls", params + ",stage=after", 1, static_cast<double>(stats.draw_calls_after), "calls");
+
+        size_t frames = builds;
+        Software_Draw_Context context(image);
+        for (const Display_List *replayed : {&list, &batched}) {
+            Bench_Timer timer;
+            for (size_t frame = 0; frame < frames; frame++) replayed->replay(context);
+            report.add("batching_cpu_replay", params + (replayed == &list ? ",source=unbatched" : ",source=batched"), 1,
+                       timer.elapsed_ns() / frames, "ns/frame");
+        }
+        bench_keep(image.pixel(10, 10));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Bench_Report report("dc_display_list", argc, argv);
+    bench_replay(report);
+    bench_damage(report);
+    bench_resource_cache(report);
+    bench_raster(report);
+    bench_batching(report);
+    return report.finish();
+}
@@ -0,0 +1,539 @@
+/**
+ * @file obj_tree_bench.cpp
+ * @brief Micro-benchmarks for the C object tree (obj_tree.c, obj_pool.c)
+ *
+ * Builds on any platform, no Windows SDK needed. Results go to stdout as
+ * JSON (or CSV with --format csv), progress goes to stderr.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <random>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_report.h"
+#include "obj_pool.h"
+#include "obj_tree.h"
+
+static std::u32string make_key(const char *prefix, size_t index)
+{
+    std::string ascii = prefix + std::to_string(index);
+    return std::u32string(ascii.begin(), ascii.end());
+}
+
+// the hash obj_tree.c used before the striped one, kept for comparison
+static Object_Key legacy_hash_char32(const char32_t *str)
+{
+    uintptr_t hash = 0;
+    while (*str) hash = hash * 31 + static_cast<uintptr_t>(*str++);
+    return static_cast<Object_Key>(hash) | OBJ_KEY_HASH_FLAG;
+}
+
+static Closure_Data *char32_hash_slot()
+{
+    Object *hash_func = obj_get_attr(obj_get_char32_string_type(), obj_attr_hash_string(U"@object.hash_function"));
+    return static_cast<Closure_Data *>(hash_func->data);
+}
+
+static void bench_churn(Bench_Report &report)
+{
+    if (!report.enabled("churn")) return;
+    size_t count = report.iterations(1000000);
+    Object *type = obj_create(0, 0);
+    obj_inc_ref(type);
+    const size_t batch = 1000;
+    std::vector<Object *> live(batch);
+    // the last pass repeats the pool one with the census counting every object
+    const char *configs[] = {"allocator=malloc", "allocator=pool", "allocator=pool,census=on"};
+    for (int config = 0; config < 3; config++) {
+        if (config) obj_pool_install();
+        else obj_debug_set_allocator(malloc, free);
+        obj_set_census(config == 2);
+        Bench_Timer timer;
+        for (size_t done = 0; done < count; done += batch) {
+            for (size_t i = 0; i < batch; i++) {
+                // sized like a short string object
+                Object *obj = obj_create(16 * sizeof(char32_t), alignof(char32_t));
+                obj_set_type(obj, type);
+                obj_inc_ref(obj);
+                live[i] = obj;
+            }
+            for (size_t i = 0; i < batch; i++) obj_dec_ref(live[i]);
+        }
+        report.add("churn", configs[config], 1, timer.elapsed_ns() / count, "ns/object");
+    }
+    obj_set_census(0);
+    obj_debug_set_allocator(malloc, free);
+}
+
+static Object *make_decorated_object(size_t attr_count, std::vector<Object_Key> &keys, Object *value)
+{
+    Object *obj = obj_create(0, 0);
+    obj_inc_ref(obj);
+    keys.clear();
+    for (size_t i = 0; i < attr_count; i++) {
+        keys.push_back(obj_attr_hash_string(make_key("attr_", i).c_str()));
+        obj_add_attr(obj, keys.back(), value);
+    }
+    return obj;
+}
+
+static void bench_attributes(Bench_Report &report)
+{
+    Object *value = obj_create(0, 0);
+    obj_inc_ref(value);
+    std::vector<Object_Key> keys;
+    std::mt19937 rng(42);
+    for (size_t attr_count : {10, 100, 1000, 10000, 100000}) {
+        std::string params = "attrs=" + std::to_string(attr_count);
+        if (report.enabled("attr_add")) {
+            for (size_t i = 0; i < attr_count; i++) obj_attr_hash_string(make_key("attr_", i).c_str()); // intern up front
+            std::vector<Object_Key> warm;
+            Object *probe = make_decorated_object(attr_count, warm, value);
+            obj_dec_ref(probe);
+            size_t rounds = report.iterations(2000000) / attr_count + 1;
+            double total = 0;
+            for (size_t r = 0; r < rounds; r++) {
+                Object *obj = obj_create(0, 0);
+                obj_inc_ref(obj);
+                Bench_Timer timer;
+                for (size_t i = 0; i < attr_count; i++) obj_add_attr(obj, warm[i], value);
+                total += timer.elapsed_ns();
+                obj_dec_ref(obj);
+            }
+            report.add("attr_add", params, 1, total / (rounds * attr_count), "ns/op");
+        }
+        if (report.enabled("attr_get") || report.enabled("iter_walk")) {
+            Object *obj = make_decorated_object(attr_count, keys, value);
+            if (report.enabled("attr_get")) {
+                size_t lookups = report.iterations(4000000);
+                std::vector<Object_Key> order(4096);
+                for (Object_Key &key : order) key = keys[rng() % keys.size()];
+                Bench_Timer timer;
+                uintptr_t acc = 0;
+                for (size_t i = 0; i < lookups; i++) acc ^= reinterpret_cast<uintptr_t>(obj_get_attr(obj, order[i & 4095]));
+                report.add("attr_get", params, 1, timer.elapsed_ns() / lookups, "ns/op");
+                bench_keep(acc);
+            }
+            if (report.enabled("iter_walk")) {
+                size_t rounds = report.iterations(4000000) / attr_count + 1;
+                Bench_Timer timer;
+                uintptr_t acc = 0;
+                for (size_t r = 0; r < rounds; r++) {
+                    Object_Attr_Iterator end = obj_attr_iter_end(obj);
+                    for (Object_Attr_Iterator it = obj_attr_iter_begin(obj); !obj_attr_iter_equal(it, end); it = obj_attr_iter_next(it)) {
+                        acc += static_cast<uintptr_t>(obj_attr_iter_key(it));
+                    }
+                }
+                report.add("iter_walk", params, 1, timer.elapsed_ns() / (rounds * attr_count), "ns/element");
+                bench_keep(acc);
+            }
+            obj_dec_ref(obj);
+        }
+    }
+    obj_dec_ref(value);
+}
+
+static void bench_interning(Bench_Report &report)
+{
+    const size_t key_count = 10000;
+    std::vector<std::u32string> names;
+    for (size_t i = 0; i < key_count; i++) names.push_back(make_key("component/", i));
+    for (const std::u32string &name : names) obj_attr_hash_string(name.c_str());
+
+    if (report.enabled("intern_lookup")) {
+        size_t lookups = report.iterations(2000000);
+        Bench_Timer timer;
+        uintptr_t acc = 0;
+        for (size_t i = 0; i < lookups; i++) acc ^= static_cast<uintptr_t>(obj_attr_hash_string(names[i % key_count].c_str()));
+        report.add("intern_lookup", "existing", 1, timer.elapsed_ns() / lookups, "ns/op");
+        bench_keep(acc);
+    }
+    if (report.enabled("intern_insert")) {
+        static size_t generation = 0;
+        size_t inserts = report.iterations(200000);
+        std::vector<std::u32string> fresh;
+        for (size_t i = 0; i < inserts; i++) fresh.push_back(make_key(("fresh" + std::to_string(generation) + "/").c_str(), i));
+        generation++;
+        Bench_Timer timer;
+        for (const std::u32string &name : fresh) obj_attr_hash_string(name.c_str());
+        report.add("intern_insert", "new", 1, timer.elapsed_ns() / inserts, "ns/op");
+    }
+    if (report.enabled("intern_stress")) {
+        // every thread looks up the shared names and interns a stream of new
+        // ones, one in eight operations being an insert
+        static size_t round = 0;
+        for (int threads : {1, 2, 4, 8, 16}) {
+            size_t ops_per_thread = report.iterations(400000);
+            std::vector<std::thread> pool;
+            size_t tag = round++;
+            Bench_Timer timer;
+            for (int t = 0; t < threads; t++) {
+                pool.emplace_back([&, t] {
+                    std::string prefix = "stress" + std::to_string(tag) + "/" + std::to_string(t) + "/";
+                    uintptr_t acc = 0;
+                    for (size_t i = 0; i < ops_per_thread; i++) {
+                        if (i % 8 == 7) acc ^= static_cast<uintptr_t>(obj_attr_hash_string(make_key(prefix.c_str(), i).c_str()));
+                        else acc ^= static_cast<uintptr_t>(obj_attr_hash_string(names[(i * 7919 + t) % key_count].c_str()));
+                    }
+                    bench_keep(acc);
+                });
+            }
+            for (std::thread &thread : pool) thread.join();
+            double seconds = timer.elapsed_ns() / 1e9;
+            report.add("intern_stress", "insert_ratio=1/8", threads, ops_per_thread * threads / seconds / 1e6, "Mops/s");
+        }
+    }
+    if (report.enabled("intern_reclaim")) {
+        // a long-running process naming components dynamically: every round
+        // interns fresh names next to the shared ones, then sweeps
+        static size_t generation = 0;
+        const size_t rounds = 50;
+        size_t per_round = report.iterations(20000);
+        std::string prefix = "dynamic" + std::to_string(generation++) + "/";
+        size_t settled_bytes = 0;
+        double sweep_ns = 0;
+        for (size_t round = 0; round < rounds; round++) {
+            for (size_t i = 0; i < per_round; i++) obj_attr_hash_string(make_key(prefix.c_str(), round * per_round + i).c_str());
+            for (const std::u32string &name : names) obj_attr_hash_string(name.c_str());
+            Bench_Timer timer;
+            obj_sweep_interned_keys();
+            sweep_ns += timer.elapsed_ns();
+            if (round == 9) settled_bytes = obj_get_intern_stats().bytes; // earlier cases' keys are gone by now
+        }
+        Obj_Intern_Stats stats = obj_get_intern_stats();
+        report.add("intern_reclaim", "table_bytes,round=10", 1, static_cast<double>(settled_bytes), "bytes");
+        report.add("intern_reclaim", "table_bytes,round=" + std::to_string(rounds), 1, static_cast<double>(stats.bytes), "bytes");
+        report.add("intern_reclaim", "live_keys,round=" + std::to_string(rounds), 1, static_cast<double>(stats.live_keys), "keys");
+        report.add("intern_reclaim", "sweep", 1, sweep_ns / rounds, "ns/sweep");
+    }
+}
+
+static void bench_string_memory(Bench_Report &report)
+{
+    if (!report.enabled("string_memory")) return;
+    const size_t count = report.iterations(100000);
+    std::vector<std::u32string> labels;
+    for (size_t i = 0; i < count; i++) labels.push_back(make_key("scene/layer_", i) + U"/label");
+    for (int compact = 0; compact < 2; compact++) {
+        size_t bytes = 0;
+        std::vector<Object *> strings;
+        for (const std::u32string &label : labels) {
+            Object *obj = compact ? obj_create_compact_string(label.c_str()) : obj_create_char32_string(label.c_str());
+            obj_inc_ref(obj);
+            bytes += obj->alloc_size;
+            strings.push_back(obj);
+        }
+        for (Object *obj : strings) obj_dec_ref(obj);
+        report.add("string_memory", compact ? "objects,compact" : "objects,char32", 1, static_cast<double>(bytes) / count, "bytes/string");
+    }
+#if defined(__GLIBC__)
+    // heap growth per newly interned key, entries included
+    static size_t generation = 0;
+    std::string prefix = "memory" + std::to_string(generation++) + "/scene/layer_";
+    size_t before = mallinfo2().uordblks;
+    for (size_t i = 0; i < count; i++) obj_attr_hash_string((make_key(prefix.c_str(), i) + U"/label").c_str());
+    size_t after = mallinfo2().uordblks;
+    report.add("string_memory", "interned_keys", 1, static_cast<double>(after - before) / count, "bytes/key");
+#endif
+}
+
+static void bench_hash(Bench_Report &report)
+{
+    Closure_Data *slot = char32_hash_slot();
+    auto hash = reinterpret_cast<Object_Key_Hash_Function>(slot->func);
+    if (report.enabled("hash_throughput")) {
+        for (size_t length : {4, 16, 64, 256, 4096}) {
+            std::u32string str;
+            for (size_t i = 0; i < length; i++) str.push_back(U'a' + static_cast<char32_t>(i % 26));
+            size_t calls = report.iterations(200000000) / (length + 16);
+            for (int legacy = 0; legacy < 2; legacy++) {
+                Bench_Timer timer;
+                uintptr_t acc = 0;
+                for (size_t i = 0; i < calls; i++) {
+                    str[0] = U'a' + static_cast<char32_t>(i & 15); // defeat hoisting
+                    acc ^= static_cast<uintptr_t>(legacy ? legacy_hash_char32(str.c_str()) : hash(slot, str.data()));
+                }
+                double bytes = static_cast<double>(calls) * length * sizeof(char32_t);
+                std::string params = "hash=" + std::string(legacy ? "legacy" : "striped") + ",chars=" + std::to_string(length);
+                report.add("hash_throughput", params, 1, bytes / timer.elapsed_ns(), "GB/s");
+                bench_keep(acc);
+            }
+        }
+    }
+    if (report.enabled("hash_occupancy")) {
+        // keys are placed with the low bits only, the way a plain "key & mask" bucket index would
+        struct Corpus { const char *name; const char *prefix; const char *suffix; };
+        const Corpus corpora[] = {
+            {"component_names", "rect_", ""},
+            {"visual_paths", "DirectComposition/root_visual/childs/", "/surface"},
+            {"attr_names", "@object.field_", ""},
+            {"decimal", "", ""},
+        };
+        const size_t bucket_log2 = 16;
+        const size_t bucket_count = size_t(1) << bucket_log2;
+        for (const Corpus &corpus : corpora) {
+            for (int legacy = 0; legacy < 2; legacy++) {
+                std::vector<uint32_t> buckets(bucket_count);
+                for (size_t i = 0; i < bucket_count; i++) {
+                    std::u32string key = make_key(corpus.prefix, i);
+                    key.append(corpus.suffix, corpus.suffix + strlen(corpus.suffix));
+                    Object_Key k = legacy ? legacy_hash_char32(key.c_str()) : hash(slot, key.data());
+                    buckets[static_cast<size_t>(k) & (bucket_count - 1)]++;
+                }
+                size_t empty = 0, max_load = 0;
+                for (uint32_t load : buckets) {
+                    if (!load) empty++;
+                    if (load > max_load) max_load = load;
+                }
+                std::string params = "corpus=" + std::string(corpus.name) + ",hash=" + (legacy ? "legacy" : "striped");
+                // a uniform hash leaves about 36.8% of the buckets empty at load 1
+                report.add("hash_occupancy_empty", params, 1, 100.0 * empty / bucket_count, "%");
+                report.add("hash_occupancy_max", params, 1, static_cast<double>(max_load), "keys/bucket");
+            }
+        }
+    }
+}
+
+static void bench_utf8(Bench_Report &report)
+{
+    if (!report.enabled("str32_to_utf8")) return;
+    for (size_t length : {16, 256}) {
+        std::u32string str;
+        for (size_t i = 0; i < length; i++) str.push_back(U'a' + static_cast<char32_t>(i % 26));
+        size_t calls = report.iterations(20000000) / length;
+        Bench_Timer timer;
+        for (size_t i = 0; i < calls; i++) {
+            char *utf8 = obj_str32_to_utf8(str.c_str());
+            bench_keep(reinterpret_cast<uintptr_t>(utf8));
+            free(utf8);
+        }
+        report.add("str32_to_utf8", "chars=" + std::to_string(length), 1, timer.elapsed_ns() / calls, "ns/call");
+    }
+}
+
+static void bench_refcount(Bench_Report &report)
+{
+    if (!report.enabled("refcount")) return;
+#ifdef OBJ_BIASED_REFCOUNT
+    const char *modes[] = {"owner", "shared"};
+    const int thread_counts[] = {1, 2, 4, 8, 16, 32};
+#else
+    // plain counts are not thread safe, only the single-threaded cost is meaningful
+    const char *modes[] = {"plain"};
+    const int thread_counts[] = {1};
+#endif
+    const size_t object_count = 64;
+    std::vector<Object *> shared_objects;
+    for (size_t i = 0; i < object_count; i++) {
+        shared_objects.push_back(obj_create(0, 0));
+        obj_inc_ref(shared_objects.back());
+    }
+    for (const char *mode : modes) {
+        bool shared = !strcmp(mode, "shared");
+        for (int threads : thread_counts) {
+            size_t ops_per_thread = report.iterations(10000000);
+            std::vector<std::thread> pool;
+            Bench_Timer timer;
+            for (int t = 0; t < threads; t++) {
+                pool.emplace_back([&] {
+                    std::vector<Object *> own;
+                    if (!shared) {
+                        for (size_t i = 0; i < object_count; i++) {
+                            own.push_back(obj_create(0, 0));
+                            obj_inc_ref(own.back());
+                        }
+                    }
+                    std::vector<Object *> &objects = shared ? shared_objects : own;
+                    for (size_t i = 0; i < ops_per_thread; i++) {
+                        Object *obj = objects[i % object_count];
+                        obj_inc_ref(obj);
+                        obj_dec_ref(obj);
+                    }
+                    for (Object *obj : own) obj_dec_ref(obj);
+                });
+            }
+            for (std::thread &thread : pool) thread.join();
+            report.add("refcount", std::string("mode=") + mode, threads, timer.elapsed_ns() / ops_per_thread, "ns/inc+dec");
+        }
+    }
+    for (Object *obj : shared_objects) obj_dec_ref(obj);
+}
+
+static void bench_refcount_array(Bench_Report &report)
+{
+    if (!report.enabled("refcount_array")) return;
+    // an array rebuild: one reference per element, taken one by one or as a batch
+    const size_t element_count = 4096;
+    std::vector<Object *> elements;
+    for (size_t i = 0; i < element_count; i++) {
+        elements.push_back(obj_create(0, 0));
+        obj_inc_ref(elements.back());
+    }
+    size_t rounds = report.iterations(2000);
+    Bench_Timer single_timer;
+    for (size_t r = 0; r < rounds; r++) {
+        for (Object *obj : elements) obj_inc_ref(obj);
+        for (Object *obj : elements) obj_dec_ref(obj);
+    }
+    report.add("refcount_array", "single,elements=" + std::to_string(element_count), 1,
+               single_timer.elapsed_ns() / (rounds * element_count), "ns/inc+dec");
+    Bench_Timer batch_timer;
+    for (size_t r = 0; r < rounds; r++) {
+        obj_inc_refs(elements.data(), element_count);
+        obj_dec_refs(elements.data(), element_count);
+    }
+    report.add("refcount_array", "batch,elements=" + std::to_string(element_count), 1,
+               batch_timer.elapsed_ns() / (rounds * element_count), "ns/inc+dec");
+    for (Object *obj : elements) obj_dec_ref(obj);
+}
+
+static void bench_destroy(Bench_Report &report)
+{
+    if (!report.enabled("destroy")) return;
+    size_t count = report.iterations(1000000);
+    auto make_chain = [count] {
+        Object *head = obj_create(0, 0);
+        obj_inc_ref(head);
+        Object *current = head;
+        for (size_t i = 0; i < count; i++) {
+            Object *next = obj_create(0, 0);
+            obj_add_attr(current, 1, next);
+            current = next;
+        }
+        return head;
+    };
+    Object *chain = make_chain();
+    Bench_Timer timer;
+    obj_dec_ref(chain);
+    report.add("destroy", "chain,immediate", 1, timer.elapsed_ns() / (count + 1), "ns/object");
+
+    chain = make_chain();
+    obj_set_deferred_free(1);
+    obj_dec_ref(chain);
+    Bench_Timer drain_timer;
+    size_t frames = 0;
+    while (obj_drain_deferred_free(10000, 0)) frames++;
+    obj_set_deferred_free(0);
+    report.add("destroy", "chain,deferred,budget=10000", 1, drain_timer.elapsed_ns() / (count + 1), "ns/object");
+    report.add("destroy_frames", "chain,deferred,budget=10000", 1, static_cast<double>(frames), "frames");
+}
+
+static void count_change(void *context, Object *, Object *)
+{
+    ++*static_cast<size_t *>(context);
+}
+
+// attribute add+remove on a leaf, untracked and tracked under a chain of ancestors
+static void bench_change_tracking(Bench_Report &report)
+{
+    if (!report.enabled("change_tracking")) return;
+    const size_t depth = 4;
+    const char *modes[] = {"off", "on", "on,subscriber"};
+    for (const char *mode : modes) {
+        std::vector<Object *> chain;
+        for (size_t i = 0; i <= depth; i++) {
+            chain.push_back(obj_create(0, 0));
+            obj_inc_ref(chain.back());
+        }
+        size_t notified = 0;
+        if (strcmp(mode, "off")) {
+            obj_track_changes(chain[0]);
+            for (size_t i = 0; i < depth; i++) obj_track_link(chain[i], chain[i + 1]);
+            if (strstr(mode, "subscriber")) obj_subscribe(chain[0], count_change, &notified);
+        }
+        Object *leaf = chain[depth];
+        Object *value = obj_create(0, 0);
+        obj_inc_ref(value);
+        size_t ops = report.iterations(5000000);
+        Bench_Timer timer;
+        for (size_t i = 0; i < ops; i++) {
+            obj_inc_ref(value);
+            obj_add_attr(leaf, 1, value);
+            obj_remove_attr(leaf, 1);
+        }
+        report.add("change_tracking", std::string("tracking=") + mode + ",depth=" + std::to_string(depth), 1,
+                   timer.elapsed_ns() / (2 * ops), "ns/mutation");
+        bench_keep(notified + obj_change_generation(chain[0]));
+        obj_dec_ref(value);
+        for (Object *obj : chain) obj_dec_ref(obj);
+    }
+}
+
+// mirrors Easy_Type_Handle from obj_helper.h, which needs the Windows SDK
+template<typename T>
+struct Bench_Type_Handle {
+    static inline Object *type = nullptr;
+};
+
+template<typename T>
+static Object *register_bench_type(std::unordered_map<std::type_index, Object *> &type_db)
+{
+    Object *type = obj_create(0, 0);
+    obj_inc_ref(type);
+    type_db[std::type_index(typeid(T))] = type;
+    Bench_Type_Handle<T>::type = type;
+    return type;
+}
+
+static void bench_type_check(Bench_Report &report)
+{
+    if (!report.enabled("type_check")) return;
+    // objects of several registered types, checked against one of them the
+    // way Easy_Object::is<T>() does, and the way is_COM_object() used to
+    std::unordered_map<std::type_index, Object *> type_db;
+    Object *types[] = {
+        register_bench_type<int>(type_db), register_bench_type<float>(type_db),
+        register_bench_type<double>(type_db), register_bench_type<short>(type_db),
+        register_bench_type<long>(type_db), register_bench_type<char>(type_db),
+        register_bench_type<unsigned>(type_db), register_bench_type<bool>(type_db),
+    };
+    std::vector<Object *> objects(4096);
+    for (size_t i = 0; i < objects.size(); i++) {
+        objects[i] = obj_create(sizeof(double), alignof(double));
+        obj_set_type(objects[i], types[i % 8]);
+        obj_inc_ref(objects[i]);
+    }
+    size_t checks = report.iterations(20000000);
+    for (int cached = 0; cached < 2; cached++) {
+        Bench_Timer timer;
+        uintptr_t acc = 0;
+        for (size_t i = 0; i < checks; i++) {
+            Object *type = cached ? Bench_Type_Handle<double>::type : type_db[std::type_index(typeid(double))];
+            acc += obj_get_type(objects[i & 4095]) == type;
+        }
+        report.add("type_check", cached ? "lookup=cached" : "lookup=type_db", 1, timer.elapsed_ns() / checks, "ns/check");
+        bench_keep(acc);
+    }
+    for (Object *obj : objects) obj_dec_ref(obj);
+    for (Object *type : types) obj_dec_ref(type);
+}
+
+int main(int argc, char **argv)
+{
+#ifdef OBJ_BIASED_REFCOUNT
+    Bench_Report report("obj_tree_biased", argc, argv);
+#else
+    Bench_Report report("obj_tree", argc, argv);
+#endif
+    obj_init_key_map();
+    bench_churn(report);
+    bench_attributes(report);
+    bench_interning(report);
+    bench_string_memory(report);
+    bench_hash(report);
+    bench_utf8(report);
+    bench_refcount(report);
+    bench_refcount_array(report);
+    bench_destroy(report);
+    bench_type_check(report);
+    bench_change_tracking(report);
+    return report.finish();
+}
@@ -0,0 +1,430 @@
+#include "dc_display_list.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+template<typename Command>
+Command *Display_List::append(Draw_Op op, size_t extra_bytes)
+{
+    static_assert(sizeof(Command) % sizeof(uint64_t) == 0, "commands must stay 8-byte aligned");
+    size_t offset = m_words.size();
+    size_t size = sizeof(Command) + (extra_bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    m_words.resize(offset + size / sizeof(uint64_t));
+    Command *command = reinterpret_cast<Command*>(m_words.data() + offset);
+    command->header.op = op;
+    command->header.size = (uint32_t)size;
+    m_command_count++;
+    return command;
+}
+
+void Display_List::fill_rect(const Draw_Rect &rect, const Draw_Color &color)
+{
+    Fill_Rect_Command *command = append<Fill_Rect_Command>(DRAW_OP_FILL_RECT);
+    command->rect = rect;
+    command->color = color;
+}
+
+void Display_List::fill_rects(const Draw_Rect *rects, size_t count, const Draw_Color &color)
+{
+    if (!count) return;
+    Fill_Rects_Command *command = append<Fill_Rects_Command>(DRAW_OP_FILL_RECTS, count * sizeof(Draw_Rect));
+    command->color = color;
+    command->bounds = {0, 0, 0, 0};
+    command->count = (uint32_t)count;
+    command->reserved = 0;
+    Draw_Rect *destination = reinterpret_cast<Draw_Rect*>(command + 1);
+    for (size_t i = 0; i < count; i++) {
+        destination[i] = rects[i];
+        command->bounds = draw_rect_union(command->bounds, rects[i]);
+    }
+}
+
+void Display_List::call(void *func, void *data, const Draw_Rect &bounds)
+{
+    Call_Command *command = append<Call_Command>(DRAW_OP_CALL);
+    command->func = func;
+    command->data = data;
+    command->bounds = bounds;
+    m_call_bounds = draw_rect_union(m_call_bounds, bounds);
+}
+
+Draw_Rect Display_List::command_bounds(const Command_Header *header)
+{
+    switch (header->op) {
+    case DRAW_OP_FILL_RECT: return reinterpret_cast<const Fill_Rect_Command*>(header)->rect;
+    case DRAW_OP_CALL: return reinterpret_cast<const Call_Command*>(header)->bounds;
+    case DRAW_OP_FILL_RECTS: return reinterpret_cast<const Fill_Rects_Command*>(header)->bounds;
+    }
+    return draw_rect_unbounded;
+}
+
+void Display_List::replay_command(Draw_Context &context, const Command_Header *header)
+{
+    switch (header->op) {
+    case DRAW_OP_FILL_RECT: {
+        const Fill_Rect_Command *command = reinterpret_cast<const Fill_Rect_Command*>(header);
+        context.fill_rect(command->rect, command->color);
+        break;
+    }
+    case DRAW_OP_CALL: {
+        const Call_Command *command = reinterpret_cast<const Call_Command*>(header);
+        context.call(command->func, command->data);
+        break;
+    }
+    case DRAW_OP_FILL_RECTS: {
+        const Fill_Rects_Command *command = reinterpret_cast<const Fill_Rects_Command*>(header);
+        context.fill_rects(command_rects(command), command->count, command->color);
+        break;
+    }
+    }
+}
+
+void Display_List::replay(Draw_Context &context) const
+{
+    const unsigned char *cursor = reinterpret_cast<const unsigned char*>(m_words.data());
+    const unsigned char *end = cursor + size_bytes();
+    while (cursor < end) {
+        const Command_Header *header = reinterpret_cast<const Command_Header*>(cursor);
+        replay_command(context, header);
+        cursor += header->size;
+    }
+}
+
+size_t Display_List::replay(Draw_Context &context, const Draw_Rect &clip) const
+{
+    size_t replayed = 0;
+    const unsigned char *cursor = reinterpret_cast<const unsigned char*>(m_words.data());
+    const unsigned char *end = cursor + size_bytes();
+    while (cursor < end) {
+        const Command_Header *header = reinterpret_cast<const Command_Header*>(cursor);
+        cursor += header->size;
+        if (!draw_rect_intersects(command_bounds(header), clip)) continue;
+        if (header->op != DRAW_OP_FILL_RECTS) {
+            replay_command(context, header);
+            replayed++;
+            continue;
+        }
+        // a batch is submitted in runs of the rects inside clip
+        const Fill_Rects_Command *command = reinterpret_cast<const Fill_Rects_Command*>(header);
+        const Draw_Rect *rects = command_rects(command);
+        size_t run = 0;
+        for (size_t i = 0; i <= command->count; i++) {
+            if (i < command->count && draw_rect_intersects(rects[i], clip)) {
+                run++;
+                continue;
+            }
+            if (run) {
+                context.fill_rects(rects + i - run, run, command->color);
+                replayed++;
+                run = 0;
+            }
+        }
+    }
+    return replayed;
+}
+
+Draw_Rect Display_List::damage_since(const Display_List &previous) const
+{
+    Draw_Rect damage = {0, 0, 0, 0};
+    const unsigned char *cursor = reinterpret_cast<const unsigned char*>(m_words.data());
+    const unsigned char *end = cursor + size_bytes();
+    const unsigned char *old_cursor = reinterpret_cast<const unsigned char*>(previous.m_words.data());
+    const unsigned char *old_end = old_cursor + previous.size_bytes();
+    // commands are plain words without padding, so equal bytes draw equal pixels;
+    // a removal that shifts the commands after it damages all of them, but
+    // component tables remove by swapping the last row in, which moves only one
+    while (cursor < end && old_cursor < old_end) {
+        const Command_Header *header = reinterpret_cast<const Command_Header*>(cursor);
+        const Command_Header *old_header = reinterpret_cast<const Command_Header*>(old_cursor);
+        if (header->op == DRAW_OP_CALL || header->size != old_header->size ||
+            memcmp(header, old_header, header->size) != 0) {
+            damage = draw_rect_union(damage, command_bounds(header));
+            damage = draw_rect_union(damage, command_bounds(old_header));
+        }
+        cursor += header->size;
+        old_cursor += old_header->size;
+    }
+    for (; cursor < end; cursor += reinterpret_cast<const Command_Header*>(cursor)->size) {
+        damage = draw_rect_union(damage, command_bounds(reinterpret_cast<const Command_Header*>(cursor)));
+    }
+    for (; old_cursor < old_end; old_cursor += reinterpret_cast<const Command_Header*>(old_cursor)->size) {
+        damage = draw_rect_union(damage, command_bounds(reinterpret_cast<const Command_Header*>(old_cursor)));
+    }
+    return damage;
+}
+
+Draw_Rect Display_List::bounds() const
+{
+    Draw_Rect bounds = {0, 0, 0, 0};
+    const unsigned char *cursor = reinterpret_cast<const unsigned char*>(m_words.data());
+    const unsigned char *end = cursor + size_bytes();
+    while (cursor < end) {
+        const Command_Header *header = reinterpret_cast<const Command_Header*>(cursor);
+        bounds = draw_rect_union(bounds, command_bounds(header));
+        cursor += header->size;
+    }
+    return bounds;
+}
+
+// what has been staged where, bucketed by a grid over a list's bounds, so
+// finding the latest command a rect would be moved across only looks at
+// its neighbours. Indices are stored plus one, 0 is none
+class Batch_Grid {
+public:
+    static constexpr int max_cells = 256;      // per axis
+    static constexpr size_t max_chain = 32;    // entries per cell before they merge into one
+
+    // cell is the preferred cell size, around that of the rects
+    Batch_Grid(const Draw_Rect &bounds, float cell_width, float cell_height)
+        : m_origin_x(bounds.left), m_origin_y(bounds.top)
+    {
+        float width = bounds.right - bounds.left, height = bounds.bottom - bounds.top;
+        m_columns = std::clamp((int)std::ceil(width / std::max(cell_width, 1.0f)), 1, max_cells);
+        m_rows = std::clamp((int)std::ceil(height / std::max(cell_height, 1.0f)), 1, max_cells);
+        m_inverse_width = 1.0f / std::max(width / m_columns, 1.0f);
+        m_inverse_height = 1.0f / std::max(height / m_rows, 1.0f);
+        m_cells.assign((size_t)m_columns * m_rows, {0, 0});
+        m_entries.reserve(m_cells.size() * 2);
+    }
+
+    size_t latest(const Draw_Rect &area) const
+    {
+        int x0, y0, x1, y1;
+        if (!cell_range(area, x0, y0, x1, y1)) return draw_rect_is_empty(area) ? m_barrier : m_newest;
+        size_t latest = m_barrier;
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                for (uint32_t entry = m_cells[(size_t)y * m_columns + x].head; entry; entry = m_entries[entry - 1].next) {
+                    const Entry &candidate = m_entries[entry - 1];
+                    if (candidate.index > latest && draw_rect_intersects(candidate.rect, area)) latest = candidate.index;
+                }
+            }
+        }
+        return latest;
+    }
+
+    void mark(const Draw_Rect &area, size_t index)
+    {
+        m_newest = std::max(m_newest, index);
+        int x0, y0, x1, y1;
+        if (!cell_range(area, x0, y0, x1, y1)) {
+            // empty areas touch nothing, areas that are not finite touch everything
+            if (!draw_rect_is_empty(area)) m_barrier = std::max(m_barrier, index);
+            return;
+        }
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                Cell &cell = m_cells[(size_t)y * m_columns + x];
+                if (cell.length == max_chain) collapse(cell);
+                m_entries.push_back({area, index, cell.head});
+                cell.head = (uint32_t)m_entries.size();
+                cell.length++;
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        Draw_Rect rect;
+        size_t index;
+        uint32_t next;
+    };
+    struct Cell {
+        uint32_t head;
+        uint32_t length;
+    };
+
+    // keeps crowded cells cheap to query, at the price of precision there
+    void collapse(Cell &cell)
+    {
+        Entry merged = {{0, 0, 0, 0}, 0, 0};
+        for (uint32_t entry = cell.head; entry; entry = m_entries[entry - 1].next) {
+            merged.rect = draw_rect_union(merged.rect, m_entries[entry - 1].rect);
+            merged.index = std::max(merged.index, m_entries[entry - 1].index);
+        }
+        m_entries.push_back(merged);
+        cell.head = (uint32_t)m_entries.size();
+        cell.length = 1;
+    }
+
+    bool cell_range(const Draw_Rect &area, int &x0, int &y0, int &x1, int &y1) const
+    {
+        if (draw_rect_is_empty(area) || !std::isfinite(area.left) || !std::isfinite(area.top) ||
+            !std::isfinite(area.right) || !std::isfinite(area.bottom)) return false;
+        x0 = first_cell((area.left - m_origin_x) * m_inverse_width, m_columns);
+        y0 = first_cell((area.top - m_origin_y) * m_inverse_height, m_rows);
+        x1 = std::max(last_cell((area.right - m_origin_x) * m_inverse_width, m_columns), x0);
+        y1 = std::max(last_cell((area.bottom - m_origin_y) * m_inverse_height, m_rows), y0);
+        return true;
+    }
+
+    // truncation is floor for the positions that are not clamped to 0
+    static int first_cell(float position, int count)
+    {
+        if (position < 1.0f) return 0;
+        return position >= (float)count ? count - 1 : (int)position;
+    }
+
+    // the cell holding the pixel just before position, the edge being exclusive
+    static int last_cell(float position, int count)
+    {
+        if (position < 1.0f) return 0;
+        if (position >= (float)count) return count - 1;
+        int cell = (int)position;
+        return (float)cell == position ? cell - 1 : cell;
+    }
+
+    float m_origin_x, m_origin_y, m_inverse_width, m_inverse_height;
+    int m_columns, m_rows;
+    std::vector<Cell> m_cells;
+    std::vector<Entry> m_entries;
+    size_t m_barrier = 0;   // the latest command touching everything
+    size_t m_newest = 0;
+};
+
+struct Batch_Color_Hash {
+    size_t operator()(const Draw_Color &color) const
+    {
+        uint64_t hash = 0;
+        for (float channel : {color.r, color.g, color.b, color.a}) {
+            uint32_t bits;
+            memcpy(&bits, &channel, sizeof(bits));
+            hash = (hash ^ bits) * 0x9E3779B97F4A7C15ull;
+        }
+        return (size_t)(hash ^ (hash >> 32));
+    }
+};
+
+// bit patterns, as the hash sees them
+struct Batch_Color_Equal {
+    bool operator()(const Draw_Color &a, const Draw_Color &b) const {return memcmp(&a, &b, sizeof(Draw_Color)) == 0;}
+};
+
+Display_List_Batch_Stats Display_List::batch(const Display_List &source)
+{
+    if (&source == this) {
+        Display_List copy = source;
+        return batch(copy);
+    }
+    // the grid spans what the list draws, commands without finite bounds
+    // aside, in cells about twice the average rect
+    Draw_Rect extent = {0, 0, 0, 0};
+    double rect_width = 0.0, rect_height = 0.0;
+    size_t rect_count = 0;
+    auto measure = [&](const Draw_Rect &bounds) {
+        if (!std::isfinite(bounds.left) || !std::isfinite(bounds.top) ||
+            !std::isfinite(bounds.right) || !std::isfinite(bounds.bottom)) return;
+        extent = draw_rect_union(extent, bounds);
+    };
+    const unsigned char *cursor = reinterpret_cast<const unsigned char*>(source.m_words.data());
+    const unsigned char *end = cursor + source.size_bytes();
+    for (; cursor < end; cursor += reinterpret_cast<const Command_Header*>(cursor)->size) {
+        const Command_Header *header = reinterpret_cast<const Command_Header*>(cursor);
+        measure(command_bounds(header));
+        if (header->op == DRAW_OP_FILL_RECT) {
+            const Draw_Rect &rect = reinterpret_cast<const Fill_Rect_Command*>(header)->rect;
+            rect_width += rect.right - rect.left;
+            rect_height += rect.bottom - rect.top;
+            rect_count++;
+        }
+        else if (header->op == DRAW_OP_FILL_RECTS) {
+            const Fill_Rects_Command *command = reinterpret_cast<const Fill_Rects_Command*>(header);
+            for (uint32_t i = 0; i < command->count; i++) {
+                rect_width += command_rects(command)[i].right - command_rects(command)[i].left;
+                rect_height += command_rects(command)[i].bottom - command_rects(command)[i].top;
+            }
+            rect_count += command->count;
+        }
+    }
+    float cell_width = rect_count && std::isfinite(rect_width) ? (float)(2.0 * rect_width / rect_count) : 64.0f;
+    float cell_height = rect_count && std::isfinite(rect_height) ? (float)(2.0 * rect_height / rect_count) : 64.0f;
+    Batch_Grid grid(extent, cell_width, cell_height);
+
+    // source commands are staged first: rects gather into batches, anything
+    // else passes through and keeps rects from moving across it if they overlap
+    struct Staged {
+        const Command_Header *command;  // nullptr for batches
+        Draw_Color color;
+        size_t count;
+    };
+    std::vector<Staged> staged;
+    std::vector<Draw_Rect> rects;
+    std::vector<size_t> owners;         // the staged batch of each rect
+    std::unordered_map<Draw_Color, size_t, Batch_Color_Hash, Batch_Color_Equal> latest_batch;
+    rects.reserve(rect_count);
+    owners.reserve(rect_count);
+    auto add_rect = [&](const Draw_Rect &rect, const Draw_Color &color) {
+        // antialiased edges reach into the pixels around, so overlap is judged on whole pixels
+        Draw_Rect pixels = {floorf(rect.left), floorf(rect.top), ceilf(rect.right), ceilf(rect.bottom)};
+        auto it = latest_batch.find(color);
+        size_t owner;
+        // same color commutes, so the rect may join its batch even where they overlap
+        if (it != latest_batch.end() && it->second + 1 >= grid.latest(pixels)) {
+            owner = it->second;
+        }
+        else {
+            owner = staged.size();
+            staged.push_back({nullptr, color, 0});
+            latest_batch[color] = owner;
+        }
+        grid.mark(pixels, owner + 1);
+        staged[owner].count++;
+        rects.push_back(rect);
+        owners.push_back(owner);
+    };
+    cursor = reinterpret_cast<const unsigned char*>(source.m_words.data());
+    while (cursor < end) {
+        const Command_Header *header = reinterpret_cast<const Command_Header*>(cursor);
+        cursor += header->size;
+        if (header->op == DRAW_OP_FILL_RECT) {
+            const Fill_Rect_Command *command = reinterpret_cast<const Fill_Rect_Command*>(header);
+            add_rect(command->rect, command->color);
+        }
+        else if (header->op == DRAW_OP_FILL_RECTS) {
+            const Fill_Rects_Command *command = reinterpret_cast<const Fill_Rects_Command*>(header);
+            for (uint32_t i = 0; i < command->count; i++) add_rect(command_rects(command)[i], command->color);
+        }
+        else {
+            staged.push_back({header, {}, 0});
+            grid.mark(command_bounds(header), staged.size());
+        }
+    }
+
+    // each batch's rects in source order, one after another
+    std::vector<size_t> first(staged.size());
+    for (size_t i = 0, offset = 0; i < staged.size(); offset += staged[i].count, i++) first[i] = offset;
+    std::vector<Draw_Rect> ordered(rects.size());
+    for (size_t i = 0; i < rects.size(); i++) ordered[first[owners[i]]++] = rects[i];
+
+    Display_List_Batch_Stats stats = {rects.size(), source.command_count(), 0, 0};
+    clear();
+    for (size_t i = 0; i < staged.size(); i++) {
+        const Staged &entry = staged[i];
+        if (entry.command) {
+            const uint64_t *words = reinterpret_cast<const uint64_t*>(entry.command);
+            m_words.insert(m_words.end(), words, words + entry.command->size / sizeof(uint64_t));
+            m_command_count++;
+            if (entry.command->op == DRAW_OP_CALL) m_call_bounds = draw_rect_union(m_call_bounds, command_bounds(entry.command));
+        }
+        else if (entry.count == 1) {
+            fill_rect(ordered[first[i] - 1], entry.color);
+        }
+        else {
+            fill_rects(ordered.data() + first[i] - entry.count, entry.count, entry.color);
+            stats.batches++;
+        }
+    }
+    stats.draw_calls_after = command_count();
+    return stats;
+}
+
+void Recording_Draw_Context::fill_rect(const Draw_Rect &rect, const Draw_Color &color)
+{
+    m_commands.push_back({DRAW_OP_FILL_RECT, rect, color, nullptr, nullptr});
+}
+
+void Recording_Draw_Context::call(void *func, void *data)
+{
+    m_commands.push_back({DRAW_OP_CALL, {}, {}, func, data});
+}
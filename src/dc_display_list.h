@@ -0,0 +1,206 @@
+/**
+ * @file dc_display_list.h
+ * @brief Flat Display Lists and Backend-Agnostic Draw Contexts
+ * @version 1.0.0
+ *
+ * A display list is a surface's components compiled into one contiguous
+ * buffer of commands, each an opcode followed by its parameters inline.
+ * Replaying it walks the buffer front to back and hands every command to a
+ * Draw_Context, which is the only part that knows the graphics API:
+ *
+ * ```cpp
+ * Display_List list;
+ * list.fill_rect({0, 0, 100, 100}, {1.0f, 0.0f, 0.0f, 1.0f});
+ * Recording_Draw_Context recorder;
+ * list.replay(recorder);
+ * ```
+ *
+ * Every command carries its bounds, so two builds of a list can be diffed
+ * into the area whose pixels changed, and a replay can skip what lies
+ * outside it:
+ *
+ * ```cpp
+ * Draw_Rect damage = list.damage_since(previous);
+ * if (!draw_rect_is_empty(damage)) list.replay(recorder, damage);
+ * ```
+ *
+ * Consecutive or non-overlapping rects of one color can be merged into a
+ * single submission by building a second list with batch(), which is meant
+ * for replay; damage is best diffed on the list it was built from, where a
+ * changed rect does not take its whole batch with it.
+ *
+ * Nothing here depends on Windows, so lists can be built, replayed and
+ * benchmarked anywhere; DC_Surface_Helper replays into Direct2D.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// same layout as D2D1_RECT_F
+struct Draw_Rect {
+    float left, top, right, bottom;
+};
+
+// the bounds of commands whose extent is unknown, they intersect everything
+inline constexpr Draw_Rect draw_rect_unbounded = {
+    -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+    std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()};
+
+inline bool draw_rect_is_empty(const Draw_Rect &rect)
+{
+    // written so that NaN edges count as empty too
+    return !(rect.left < rect.right && rect.top < rect.bottom);
+}
+
+inline bool draw_rect_intersects(const Draw_Rect &a, const Draw_Rect &b)
+{
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+// the bounding box of both, an empty rect adds nothing
+inline Draw_Rect draw_rect_union(const Draw_Rect &a, const Draw_Rect &b)
+{
+    if (draw_rect_is_empty(a)) return b;
+    if (draw_rect_is_empty(b)) return a;
+    return {a.left < b.left ? a.left : b.left, a.top < b.top ? a.top : b.top,
+            a.right > b.right ? a.right : b.right, a.bottom > b.bottom ? a.bottom : b.bottom};
+}
+
+inline Draw_Rect draw_rect_intersection(const Draw_Rect &a, const Draw_Rect &b)
+{
+    return {a.left > b.left ? a.left : b.left, a.top > b.top ? a.top : b.top,
+            a.right < b.right ? a.right : b.right, a.bottom < b.bottom ? a.bottom : b.bottom};
+}
+
+// same layout as D2D1_COLOR_F
+struct Draw_Color {
+    float r, g, b, a;
+};
+
+enum Draw_Op : uint32_t {
+    DRAW_OP_FILL_RECT,
+    DRAW_OP_CALL,       // a component with its own draw function
+    DRAW_OP_FILL_RECTS, // rects sharing a color, submitted at once
+};
+
+struct Display_List_Batch_Stats {
+    size_t rects;
+    size_t draw_calls_before;   // commands of the source list
+    size_t draw_calls_after;    // commands of the batched list
+    size_t batches;             // commands holding more than one rect
+};
+
+class Draw_Context {
+public:
+    virtual ~Draw_Context() = default;
+
+    virtual void fill_rect(const Draw_Rect &rect, const Draw_Color &color) = 0;
+    // the order of the rects is not significant; backends that cannot submit
+    // them at once keep this default
+    virtual void fill_rects(const Draw_Rect *rects, size_t count, const Draw_Color &color)
+    {
+        for (size_t i = 0; i < count; i++) fill_rect(rects[i], color);
+    }
+    // func is the component's draw function, its signature is the backend's business
+    virtual void call(void *func, void *data) = 0;
+};
+
+class Display_List {
+public:
+    void clear() {m_words.clear(); m_command_count = 0; m_call_bounds = {0, 0, 0, 0};}
+    void reserve(size_t commands) {m_words.reserve(commands * sizeof(Fill_Rect_Command) / sizeof(uint64_t));}
+
+    void fill_rect(const Draw_Rect &rect, const Draw_Color &color);
+    void fill_rects(const Draw_Rect *rects, size_t count, const Draw_Color &color);
+    // data is borrowed, it must live until the list is cleared or rebuilt.
+    // Without bounds the component is redrawn whenever anything is
+    void call(void *func, void *data, const Draw_Rect &bounds = draw_rect_unbounded);
+
+    void replay(Draw_Context &context) const;
+    // only the commands whose bounds intersect clip; returns how many that was
+    size_t replay(Draw_Context &context, const Draw_Rect &clip) const;
+
+    // the union of the bounds of every command that differs from the one at
+    // the same position in previous, or has no counterpart there; empty if
+    // drawing either list gives the same pixels. Call commands always count
+    // as changed, what their data holds is not known here
+    Draw_Rect damage_since(const Display_List &previous) const;
+    // the union of every command's bounds
+    Draw_Rect bounds() const;
+    // the union of the call commands' bounds: what they draw depends on their
+    // data at replay time, so this area must be redrawn on every frame
+    const Draw_Rect &call_bounds() const {return m_call_bounds;}
+
+    // rebuilds this list from source with its rects batched by color: a rect
+    // joins the latest batch of its color if nothing drawn since overlaps
+    // it, so the pixels come out the same
+    Display_List_Batch_Stats batch(const Display_List &source);
+
+    size_t command_count() const {return m_command_count;}
+    size_t size_bytes() const {return m_words.size() * sizeof(uint64_t);}
+    bool empty() const {return m_command_count == 0;}
+
+private:
+    struct Command_Header {
+        Draw_Op op;
+        uint32_t size;  // bytes of the whole command, header included
+    };
+    struct Fill_Rect_Command {
+        Command_Header header;
+        Draw_Rect rect;
+        Draw_Color color;
+    };
+    struct Call_Command {
+        Command_Header header;
+        void *func;
+        void *data;
+        Draw_Rect bounds;
+    };
+    // followed by count Draw_Rects
+    struct Fill_Rects_Command {
+        Command_Header header;
+        Draw_Color color;
+        Draw_Rect bounds;
+        uint32_t count;
+        uint32_t reserved;
+    };
+
+    static const Draw_Rect *command_rects(const Fill_Rects_Command *command)
+    {
+        return reinterpret_cast<const Draw_Rect*>(command + 1);
+    }
+    static Draw_Rect command_bounds(const Command_Header *header);
+    static void replay_command(Draw_Context &context, const Command_Header *header);
+    template<typename Command> Command *append(Draw_Op op, size_t extra_bytes = 0);
+
+    std::vector<uint64_t> m_words;  // 8-byte words keep every command aligned
+    size_t m_command_count = 0;
+    Draw_Rect m_call_bounds = {0, 0, 0, 0};
+};
+
+// keeps every command it is given, for tests and for measuring replay
+// without a graphics device
+class Recording_Draw_Context : public Draw_Context {
+public:
+    struct Command {
+        Draw_Op op;
+        Draw_Rect rect;     // DRAW_OP_FILL_RECT only
+        Draw_Color color;
+        void *func;         // DRAW_OP_CALL only
+        void *data;
+    };
+
+    void fill_rect(const Draw_Rect &rect, const Draw_Color &color) override;
+    void call(void *func, void *data) override;
+
+    const std::vector<Command> &commands() const {return m_commands;}
+    // keeps the capacity, so replaying into the same recorder again does not allocate
+    void clear() {m_commands.clear();}
+
+private:
+    std::vector<Command> m_commands;
+};
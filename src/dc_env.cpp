@@ -2,6 +2,7 @@
 #include <string>
 
 #include "dc_env.h"
+#include "dc_surface.h"
 
 DC_Env* DC_Env::s_application;
 
@@ -59,9 +60,12 @@ Easy_Object DC_Env::createSurfaceForVisual(Easy_Object visual, int width, int he
     visual_obj->SetContent(surface);
     Easy_Object ret = Easy_Object::make_map();
     ret.insert("data", Easy_Object::pack_COM_object(surface));
+    SIZE size = {width, height};
+    ret.insert("size", Easy_Object::make_raw(&size, sizeof(SIZE), alignof(SIZE)));
     visual.insert("surface", ret);
     Easy_Object context_data = Easy_Object::pack_COM_object(m_d2dContext);
     ret.insert("context", context_data);
+    ret.insert("resources", m_d2dResources);
     return ret;
 }
 
@@ -238,6 +242,11 @@ HRESULT DC_Env::CreateD3D11Device()
         hr = m_d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, &m_d2dContext);
     }
 
+    if (SUCCEEDED(hr))
+    {
+        m_d2dResources = DC_Surface_Helper::make_resources(m_d2dContext);
+    }
+
     return hr;
 }
 
@@ -389,6 +398,8 @@ VOID DC_Env::DestroyDCompositionDevice()
 
 VOID DC_Env::DestroyD3D11Device()
 {
+    DC_Surface_Helper::release_resources(m_d2dResources);
+    m_d2dResources = Easy_Object();
     _d3d11DeviceContext = nullptr;
     _d3d11Device = nullptr;
 }
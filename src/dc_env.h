@@ -84,6 +84,7 @@ private:
     CComPtr<IDXGIDevice> m_dxgiDevice;
     CComPtr<ID2D1Device> m_d2dDevice;
     CComPtr<ID2D1DeviceContext> m_d2dContext;
+    Easy_Object m_d2dResources;     // brush cache of m_d2dContext, shared by its surfaces
 
     CComPtr<IDCompositionDevice> m_pDevice;
     CComPtr<IDCompositionTarget> m_pHwndRenderTarget;
@@ -0,0 +1,87 @@
+#include "dc_resource_cache.h"
+#include <bit>
+
+static uint32_t float_bits(float value)
+{
+    return std::bit_cast<uint32_t>(value);
+}
+
+bool Draw_Resource_Desc::operator==(const Draw_Resource_Desc &other) const
+{
+    return kind == other.kind &&
+        float_bits(color.r) == float_bits(other.color.r) && float_bits(color.g) == float_bits(other.color.g) &&
+        float_bits(color.b) == float_bits(other.color.b) && float_bits(color.a) == float_bits(other.color.a) &&
+        float_bits(stroke_width) == float_bits(other.stroke_width);
+}
+
+size_t Draw_Resource_Desc_Hash::operator()(const Draw_Resource_Desc &desc) const
+{
+    uint64_t words[3] = {
+        (uint64_t)float_bits(desc.color.r) << 32 | float_bits(desc.color.g),
+        (uint64_t)float_bits(desc.color.b) << 32 | float_bits(desc.color.a),
+        (uint64_t)desc.kind << 32 | float_bits(desc.stroke_width),
+    };
+    uint64_t hash = 0;
+    for (uint64_t word : words) {
+        // boost-style combine over a 64-bit multiplicative mix
+        word *= 0x9E3779B97F4A7C15ull;
+        hash ^= (word ^ (word >> 32)) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    }
+    return (size_t)hash;
+}
+
+Draw_Resource_Cache::Draw_Resource_Cache(Draw_Resource_Factory &factory, size_t capacity)
+    : m_factory(factory), m_capacity(capacity ? capacity : 1)
+{
+}
+
+void *Draw_Resource_Cache::get(const Draw_Resource_Desc &desc)
+{
+    // runs of one color are common, and need neither a hash nor a splice
+    if (!m_entries.empty() && m_entries.front().desc == desc) {
+        m_hits++;
+        return m_entries.front().resource;
+    }
+    auto it = m_index.find(desc);
+    if (it != m_index.end()) {
+        m_hits++;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return it->second->resource;
+    }
+    m_misses++;
+    void *resource = m_factory.create(desc);
+    if (!resource) return nullptr;
+    evict_to(m_capacity - 1);
+    m_entries.push_front({desc, resource});
+    m_index.emplace(desc, m_entries.begin());
+    return resource;
+}
+
+void Draw_Resource_Cache::evict_to(size_t size)
+{
+    while (m_entries.size() > size) {
+        Entry &victim = m_entries.back();
+        m_index.erase(victim.desc);
+        m_factory.release(victim.resource);
+        m_entries.pop_back();
+        m_evictions++;
+    }
+}
+
+void Draw_Resource_Cache::clear()
+{
+    for (Entry &entry : m_entries) m_factory.release(entry.resource);
+    m_entries.clear();
+    m_index.clear();
+}
+
+void Draw_Resource_Cache::set_capacity(size_t capacity)
+{
+    m_capacity = capacity ? capacity : 1;
+    evict_to(m_capacity);
+}
+
+Draw_Resource_Stats Draw_Resource_Cache::stats() const
+{
+    return {m_hits, m_misses, m_evictions, m_entries.size(), m_capacity};
+}
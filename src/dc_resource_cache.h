@@ -0,0 +1,96 @@
+/**
+ * @file dc_resource_cache.h
+ * @brief LRU Cache of Device Drawing Resources
+ * @version 1.0.0
+ *
+ * Brushes and similar device resources are cheap to use and costly to
+ * create, so components fetch them from a cache keyed by their parameters
+ * instead of creating one per draw. The cache only sees resources as opaque
+ * pointers made and released by a Draw_Resource_Factory, so the backend
+ * (Direct2D in dc_surface.cpp) or a mock can stand behind it:
+ *
+ * ```cpp
+ * Draw_Resource_Cache cache(factory, 64);
+ * auto *brush = (ID2D1SolidColorBrush*)cache.get(Draw_Resource_Desc::solid_brush(color));
+ * ```
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+#include "dc_display_list.h"
+
+enum Draw_Resource_Kind : uint32_t {
+    DRAW_RESOURCE_SOLID_BRUSH,
+};
+
+struct Draw_Resource_Desc {
+    Draw_Resource_Kind kind;
+    Draw_Color color;
+    float stroke_width;     // 0 for fills
+
+    static Draw_Resource_Desc solid_brush(const Draw_Color &color) {return {DRAW_RESOURCE_SOLID_BRUSH, color, 0.0f};}
+
+    // compares bit patterns, as the hash does, so -0.0f and 0.0f are two keys
+    bool operator==(const Draw_Resource_Desc &other) const;
+};
+
+struct Draw_Resource_Desc_Hash {
+    size_t operator()(const Draw_Resource_Desc &desc) const;
+};
+
+class Draw_Resource_Factory {
+public:
+    virtual ~Draw_Resource_Factory() = default;
+
+    // a new resource for the cache to own, nullptr if it cannot be made
+    virtual void *create(const Draw_Resource_Desc &desc) = 0;
+    virtual void release(void *resource) = 0;
+};
+
+struct Draw_Resource_Stats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t size;        // resources held now
+    size_t capacity;
+};
+
+class Draw_Resource_Cache {
+public:
+    Draw_Resource_Cache(Draw_Resource_Factory &factory, size_t capacity);
+    ~Draw_Resource_Cache() {clear();}
+    Draw_Resource_Cache(const Draw_Resource_Cache &) = delete;
+    Draw_Resource_Cache &operator=(const Draw_Resource_Cache &) = delete;
+
+    // borrowed; a miss may evict the least recently used resource, so use it
+    // before fetching capacity more. nullptr if the factory failed
+    void *get(const Draw_Resource_Desc &desc);
+    // releases every resource, e.g. before the device goes away
+    void clear();
+    void set_capacity(size_t capacity);
+
+    Draw_Resource_Stats stats() const;
+    void reset_stats() {m_hits = m_misses = m_evictions = 0;}
+
+private:
+    struct Entry {
+        Draw_Resource_Desc desc;
+        void *resource;
+    };
+    typedef std::list<Entry> Entry_List;
+
+    void evict_to(size_t size);
+
+    Draw_Resource_Factory &m_factory;
+    size_t m_capacity;
+    Entry_List m_entries;   // most recently used first
+    std::unordered_map<Draw_Resource_Desc, Entry_List::iterator, Draw_Resource_Desc_Hash> m_index;
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+    size_t m_evictions = 0;
+};
@@ -0,0 +1,193 @@
+#include "dc_software_raster.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DC_RASTER_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DC_RASTER_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define DC_RASTER_NEON
+#endif
+
+Raster_Image::Raster_Image(int width, int height)
+    : m_width(width > 0 ? width : 0), m_height(height > 0 ? height : 0), m_pixels((size_t)m_width * m_height)
+{
+}
+
+void Raster_Image::clear(uint32_t pixel)
+{
+    std::fill(m_pixels.begin(), m_pixels.end(), pixel);
+}
+
+static uint32_t unit_to_byte(float value)
+{
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (uint32_t)(value * 255.0f + 0.5f);
+}
+
+uint32_t raster_pixel(const Draw_Color &color, float coverage)
+{
+    float alpha = color.a * coverage;
+    if (!(alpha > 0.0f)) return 0;
+    alpha = alpha > 1.0f ? 1.0f : alpha;
+    return unit_to_byte(alpha) << 24 | unit_to_byte(color.r * alpha) << 16 |
+        unit_to_byte(color.g * alpha) << 8 | unit_to_byte(color.b * alpha);
+}
+
+static uint32_t blend_pixel(uint32_t dst, uint32_t src)
+{
+    uint32_t inverse = 255 - (src >> 24);
+    // two channels at a time, each 16 bits wide: B and R, then G and A
+    uint32_t even = (dst & 0x00FF00FF) * inverse + 0x00800080;
+    uint32_t odd = ((dst >> 8) & 0x00FF00FF) * inverse + 0x00800080;
+    even = ((even + ((even >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    odd = (odd + ((odd >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    uint32_t scaled = even | odd, blended = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t channel = ((src >> shift) & 0xFF) + ((scaled >> shift) & 0xFF);
+        blended |= (channel > 255 ? 255 : channel) << shift;
+    }
+    return blended;
+}
+
+// dst = src + dst * (255 - src alpha) / 255 per channel, 16 bits wide in
+// between; premultiplied channels never exceed alpha, the saturating add
+// only guards against malformed input
+void raster_blend_span(uint32_t *dst, size_t count, uint32_t src)
+{
+    uint32_t alpha = src >> 24;
+    if (alpha == 255) {
+        std::fill_n(dst, count, src);
+        return;
+    }
+    if (src == 0) return;
+    size_t i = 0;
+#if defined(DC_RASTER_AVX2)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i source = _mm256_set1_epi32((int)src);
+        const __m256i inverse = _mm256_set1_epi16((short)(255 - alpha));
+        const __m256i bias = _mm256_set1_epi16(128);
+        for (; i + 8 <= count; i += 8) {
+            __m256i pixels = _mm256_loadu_si256((const __m256i*)(dst + i));
+            __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, zero), inverse), bias);
+            __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, zero), inverse), bias);
+            lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+            hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), source));
+        }
+    }
+#endif
+#if defined(DC_RASTER_SSE2)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i source = _mm_set1_epi32((int)src);
+        const __m128i inverse = _mm_set1_epi16((short)(255 - alpha));
+        const __m128i bias = _mm_set1_epi16(128);
+        for (; i + 4 <= count; i += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(dst + i));
+            __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), inverse), bias);
+            __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), inverse), bias);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(_mm_packus_epi16(lo, hi), source));
+        }
+    }
+#elif defined(DC_RASTER_NEON)
+    {
+        const uint8x16_t source = vreinterpretq_u8_u32(vdupq_n_u32(src));
+        const uint8x8_t inverse = vdup_n_u8((uint8_t)(255 - alpha));
+        for (; i + 4 <= count; i += 4) {
+            uint8x16_t pixels = vld1q_u8((const uint8_t*)(dst + i));
+            uint16x8_t lo = vmull_u8(vget_low_u8(pixels), inverse);
+            uint16x8_t hi = vmull_u8(vget_high_u8(pixels), inverse);
+            // (x + ((x + 128) >> 8) + 128) >> 8, the same rounding as blend_pixel()
+            uint8x16_t scaled = vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)), vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+            vst1q_u8((uint8_t*)(dst + i), vqaddq_u8(scaled, source));
+        }
+    }
+#endif
+    for (; i < count; i++) dst[i] = blend_pixel(dst[i], src);
+}
+
+Software_Draw_Context::Software_Draw_Context(Raster_Image &target, const Draw_Rect &clip)
+    : m_target(target),
+      m_clip(draw_rect_intersection(clip, {0.0f, 0.0f, (float)target.width(), (float)target.height()}))
+{
+}
+
+void Software_Draw_Context::fill_rect(const Draw_Rect &rect, const Draw_Color &color)
+{
+    uint32_t solid = raster_pixel(color);
+    if (solid) fill_area(rect, color, solid);
+}
+
+void Software_Draw_Context::fill_rects(const Draw_Rect *rects, size_t count, const Draw_Color &color)
+{
+    // the batch shares its color, so the interior pixel is converted once
+    uint32_t solid = raster_pixel(color);
+    if (!solid) return;
+    for (size_t i = 0; i < count; i++) fill_area(rects[i], color, solid);
+}
+
+void Software_Draw_Context::fill_area(const Draw_Rect &rect, const Draw_Color &color, uint32_t solid)
+{
+    Draw_Rect area = draw_rect_intersection(rect, m_clip);
+    if (draw_rect_is_empty(area)) return;
+    int x0 = (int)floorf(area.left), x1 = (int)ceilf(area.right);
+    int y0 = (int)floorf(area.top), y1 = (int)ceilf(area.bottom);
+    // coverage of the edge columns; the columns between are covered fully
+    float left_coverage = std::min((float)(x0 + 1), area.right) - area.left;
+    float right_coverage = area.right - std::max((float)(x1 - 1), area.left);
+    int inner_x0 = left_coverage < 1.0f ? x0 + 1 : x0;
+    int inner_x1 = right_coverage < 1.0f ? x1 - 1 : x1;
+    if (x1 - x0 == 1) {
+        // a single column, drawn as the left edge
+        inner_x0 = inner_x1 = x1;
+        left_coverage = area.right - area.left;
+    }
+    // fully covered rows share their pixels, only the top and bottom rows need their own
+    uint32_t left = raster_pixel(color, left_coverage), right = raster_pixel(color, right_coverage);
+    for (int y = y0; y < y1; y++) {
+        float row_coverage = std::min((float)(y + 1), area.bottom) - std::max((float)y, area.top);
+        uint32_t row_left = left, row_middle = solid, row_right = right;
+        if (row_coverage < 1.0f) {
+            row_left = raster_pixel(color, left_coverage * row_coverage);
+            row_middle = raster_pixel(color, row_coverage);
+            row_right = raster_pixel(color, right_coverage * row_coverage);
+        }
+        uint32_t *row = m_target.row(y);
+        if (inner_x0 != x0) row[x0] = blend_pixel(row[x0], row_left);
+        if (inner_x1 > inner_x0) raster_blend_span(row + inner_x0, (size_t)(inner_x1 - inner_x0), row_middle);
+        if (inner_x1 != x1) row[x1 - 1] = blend_pixel(row[x1 - 1], row_right);
+    }
+    m_pixels_blended += (uint64_t)(x1 - x0) * (uint64_t)(y1 - y0);
+}
+
+void Software_Draw_Context::call(void *func, void *data)
+{
+    auto it = m_fallbacks.find(func);
+    if (it == m_fallbacks.end()) {
+        m_skipped_calls++;
+        return;
+    }
+    it->second(data, *this);
+}
+
+const char *Software_Draw_Context::simd_name()
+{
+#if defined(DC_RASTER_AVX2)
+    return "avx2";
+#elif defined(DC_RASTER_SSE2)
+    return "sse2";
+#elif defined(DC_RASTER_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
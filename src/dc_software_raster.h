@@ -0,0 +1,93 @@
+/**
+ * @file dc_software_raster.h
+ * @brief CPU Rasterizer Backend for Display Lists
+ * @version 1.0.0
+ *
+ * Replays display lists into an in-memory premultiplied BGRA image instead
+ * of a Direct2D context, so a surface's scene renders headless, e.g. on a
+ * server for thumbnails or in golden-image tests:
+ *
+ * ```cpp
+ * Raster_Image image(256, 256);
+ * Software_Draw_Context context(image);
+ * helper.display_list().replay(context);
+ * uint32_t corner = image.pixel(0, 0);    // 0xAARRGGBB, premultiplied
+ * ```
+ *
+ * Rects are antialiased by area coverage and composited source-over. Spans
+ * are blended with AVX2, SSE2 or NEON, whichever the build targets.
+ *
+ * Component draw functions take a Direct2D context, so call commands are only
+ * drawn if a CPU counterpart was registered for the function with
+ * set_call_fallback(); the others are counted and skipped.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "dc_display_list.h"
+
+// one 32-bit pixel per element, B G R A in memory, alpha premultiplied
+class Raster_Image {
+public:
+    Raster_Image() = default;
+    Raster_Image(int width, int height);
+
+    int width() const {return m_width;}
+    int height() const {return m_height;}
+    uint32_t *row(int y) {return m_pixels.data() + (size_t)y * m_width;}
+    const uint32_t *row(int y) const {return m_pixels.data() + (size_t)y * m_width;}
+    uint32_t pixel(int x, int y) const {return row(y)[x];}
+    std::span<const uint32_t> pixels() const {return m_pixels;}
+
+    void clear(uint32_t pixel = 0);
+
+private:
+    int m_width = 0;
+    int m_height = 0;
+    std::vector<uint32_t> m_pixels;
+};
+
+// the premultiplied pixel of a straight-alpha color, scaled by coverage
+uint32_t raster_pixel(const Draw_Color &color, float coverage = 1.0f);
+
+// source-over of one premultiplied pixel onto count pixels
+void raster_blend_span(uint32_t *dst, size_t count, uint32_t src);
+
+class Software_Draw_Context;
+typedef void (*Software_Draw_Function)(void *data, Software_Draw_Context &context);
+
+class Software_Draw_Context : public Draw_Context {
+public:
+    // draws into target, nothing outside clip
+    explicit Software_Draw_Context(Raster_Image &target, const Draw_Rect &clip = draw_rect_unbounded);
+
+    void fill_rect(const Draw_Rect &rect, const Draw_Color &color) override;
+    void fill_rects(const Draw_Rect *rects, size_t count, const Draw_Color &color) override;
+    void call(void *func, void *data) override;
+
+    // draws the call commands of func with cpu_func
+    void set_call_fallback(void *func, Software_Draw_Function cpu_func) {m_fallbacks[func] = cpu_func;}
+
+    Raster_Image &target() {return m_target;}
+    uint64_t pixels_blended() const {return m_pixels_blended;}
+    size_t skipped_calls() const {return m_skipped_calls;}
+
+    // "avx2", "sse2", "neon" or "scalar"
+    static const char *simd_name();
+
+private:
+    // solid is raster_pixel(color)
+    void fill_area(const Draw_Rect &rect, const Draw_Color &color, uint32_t solid);
+
+    Raster_Image &m_target;
+    Draw_Rect m_clip;
+    std::unordered_map<void*, Software_Draw_Function> m_fallbacks;
+    uint64_t m_pixels_blended = 0;
+    size_t m_skipped_calls = 0;
+};
@@ -1,37 +1,232 @@
 #include "dc_surface.h"
 #include <atlbase.h>
+#include <cmath>
 
+static_assert(sizeof(Draw_Rect) == sizeof(D2D1_RECT_F) && sizeof(Draw_Color) == sizeof(D2D1_COLOR_F));
+
+static Draw_Rect rect_bounds(const Rect_Data &rect)
+{
+    return {rect.x, rect.y, rect.x + rect.width, rect.y + rect.height};
+}
+
+static Draw_Color rect_color(const D2D1_COLOR_F &color)
+{
+    return {color.r, color.g, color.b, color.a};
+}
+
+// makes Direct2D resources for a Draw_Resource_Cache, keeping their context alive
+class D2D_Resource_Factory : public Draw_Resource_Factory {
+public:
+    explicit D2D_Resource_Factory(ID2D1DeviceContext *context) : m_context(context) {}
+
+    void *create(const Draw_Resource_Desc &desc) override
+    {
+        switch (desc.kind) {
+        case DRAW_RESOURCE_SOLID_BRUSH: {
+            ID2D1SolidColorBrush *brush = nullptr;
+            D2D1_COLOR_F color = {desc.color.r, desc.color.g, desc.color.b, desc.color.a};
+            if (FAILED(m_context->CreateSolidColorBrush(color, &brush))) return nullptr;
+            return brush;
+        }
+        }
+        return nullptr;
+    }
+
+    // every resource made above is a single-inheritance COM object
+    void release(void *resource) override {static_cast<IUnknown*>(resource)->Release();}
+
+    // lets the context go; nothing can be created afterwards
+    void detach() {m_context.Release();}
+
+private:
+    CComPtr<ID2D1DeviceContext> m_context;
+};
+
+// the cache of one device context, an object in the tree so that every
+// surface drawing with the context can share it and the owner of the
+// context decides when it goes away. Like the context itself it is used
+// by one thread at a time
+struct D2D_Context_Resources {
+    explicit D2D_Context_Resources(ID2D1DeviceContext *context)
+        : factory(context), cache(factory, DC_Surface_Helper::resource_cache_capacity) {}
+
+    D2D_Resource_Factory factory;
+    Draw_Resource_Cache cache;
+};
+
+Easy_Object DC_Surface_Helper::make_resources(ID2D1DeviceContext *context)
+{
+    if (!Easy_Type_Handle<D2D_Context_Resources>::type) {
+        Easy_Object::type_register<D2D_Context_Resources>(U"d2d_context_resources");
+    }
+    Object *obj = obj_create(sizeof(D2D_Context_Resources), alignof(D2D_Context_Resources));
+    obj_debug_add_tag(obj, U"d2d_context_resources");
+    new (obj->data) D2D_Context_Resources(context);
+    obj_set_type(obj, Easy_Type_Handle<D2D_Context_Resources>::type);
+    return Easy_Object(obj);
+}
+
+void DC_Surface_Helper::release_resources(const Easy_Object &resources)
+{
+    D2D_Context_Resources *data = resources.borrow().data_as<D2D_Context_Resources>();
+    if (!data) return;
+    // surfaces may still hold the object, but nothing of the device stays alive
+    data->cache.clear();
+    data->factory.detach();
+}
+
+// set while compile() replays, so that draw functions reach the cache
+static thread_local Draw_Resource_Cache *current_cache = nullptr;
+
+Draw_Resource_Cache *DC_Surface_Helper::current_resources()
+{
+    return current_cache;
+}
 
 static void draw_rect(void* data, ID2D1DeviceContext* render_target, POINT offset)
 {
     Rect_Data *rect_data = (Rect_Data*)data;
-    ID2D1SolidColorBrush *brush;
-    render_target->CreateSolidColorBrush(rect_data->color, &brush);
-    render_target->FillRectangle(D2D1::RectF(rect_data->x, rect_data->y, rect_data->x + rect_data->width, rect_data->y + rect_data->height), brush);
+    Draw_Resource_Cache *resources = DC_Surface_Helper::current_resources();
+    if (!resources) return;
+    void *brush = resources->get(Draw_Resource_Desc::solid_brush(rect_color(rect_data->color)));
+    if (!brush) return;
+    Draw_Rect bounds = rect_bounds(*rect_data);
+    render_target->FillRectangle(D2D1::RectF(bounds.left + offset.x, bounds.top + offset.y,
+        bounds.right + offset.x, bounds.bottom + offset.y), (ID2D1SolidColorBrush*)brush);
 }
 
 void DC_Surface_Helper::addRect(const std::string &name, Rect_Data rect_data)
 {
     Easy_Object rect_obj = Easy_Object::make_map();
     m_surface_obj.get("components").insert(name, rect_obj);
-    rect_obj.insert("type", Easy_Object::make_char32_string(U"rect"));
+    rect_obj.insert("type", Easy_Object::make_compact_string(U"rect"));
     Easy_Object rect_data_obj = Easy_Object::make_raw(&rect_data, sizeof(Rect_Data), alignof(Rect_Data));
-    rect_obj.insert("data", rect_data_obj);
+    rect_obj.insert("data", std::move(rect_data_obj));
     Component_Draw_Function draw_func = draw_rect;
     rect_obj.insert("draw_func", Easy_Object::make_raw(&draw_func, sizeof(Component_Draw_Function*), alignof(Component_Draw_Function*)));
 }
 
+// replays display lists into Direct2D with brushes from the context's cache;
+// offset is where the surface's origin lands in the target bitmap
+class D2D_Draw_Context : public Draw_Context {
+public:
+    D2D_Draw_Context(ID2D1DeviceContext *context, POINT offset, Draw_Resource_Cache &resources)
+        : m_context(context), m_offset(offset), m_resources(resources) {}
+
+    void fill_rect(const Draw_Rect &rect, const Draw_Color &color) override
+    {
+        void *brush = m_resources.get(Draw_Resource_Desc::solid_brush(color));
+        if (!brush) return;
+        float x = (float)m_offset.x, y = (float)m_offset.y;
+        m_context->FillRectangle(D2D1::RectF(rect.left + x, rect.top + y, rect.right + x, rect.bottom + y), (ID2D1SolidColorBrush*)brush);
+    }
+
+    // Direct2D merges consecutive fills with one brush into a single GPU batch
+    // itself, so a batch needs one brush lookup and no geometry
+    void fill_rects(const Draw_Rect *rects, size_t count, const Draw_Color &color) override
+    {
+        void *brush = m_resources.get(Draw_Resource_Desc::solid_brush(color));
+        if (!brush) return;
+        float x = (float)m_offset.x, y = (float)m_offset.y;
+        for (size_t i = 0; i < count; i++) {
+            const Draw_Rect &rect = rects[i];
+            m_context->FillRectangle(D2D1::RectF(rect.left + x, rect.top + y, rect.right + x, rect.bottom + y), (ID2D1SolidColorBrush*)brush);
+        }
+    }
+
+    void call(void *func, void *data) override
+    {
+        ((Component_Draw_Function)func)(data, m_context, m_offset);
+    }
+
+private:
+    ID2D1DeviceContext *m_context;
+    POINT m_offset;
+    Draw_Resource_Cache &m_resources;
+};
+
+void DC_Surface_Helper::rebuild_display_list()
+{
+    static const Easy_Key data_key("data"), components_key("components"), draw_func_key("draw_func"), bounds_key("bounds");
+    m_display_list.clear();
+    // the rect table first, down its columns
+    std::span<float> x = m_rects.column(&Rect_Data::x), y = m_rects.column(&Rect_Data::y);
+    std::span<float> width = m_rects.column(&Rect_Data::width), height = m_rects.column(&Rect_Data::height);
+    std::span<D2D1_COLOR_F> color = m_rects.column(&Rect_Data::color);
+    for (size_t i = 0; i < m_rects.size(); i++) {
+        m_display_list.fill_rect({x[i], y[i], x[i] + width[i], y[i] + height[i]}, rect_color(color[i]));
+    }
+    Easy_Object_Ref components = m_surface_obj.borrow().get(components_key);
+    for (auto &pair : *components.get_map_data()) {
+        Easy_Object_Ref component = pair.second;
+        Component_Draw_Function draw_func = *((Component_Draw_Function*)component.get(draw_func_key).get_data_ptr());
+        void *data = component.get(data_key).get_data_ptr();
+        if (draw_func == draw_rect) {
+            const Rect_Data *rect = (const Rect_Data*)data;
+            m_display_list.fill_rect(rect_bounds(*rect), rect_color(rect->color));
+        }
+        else {
+            // custom components may declare where they draw, else they damage the whole surface
+            Easy_Object_Ref bounds = component.get(bounds_key);
+            m_display_list.call((void*)draw_func, data,
+                bounds.is_null() ? draw_rect_unbounded : *(const Draw_Rect*)bounds.get_data_ptr());
+        }
+    }
+    m_batch_stats = m_batched_list.batch(m_display_list);
+    m_display_list_generation = m_surface_obj.change_generation();
+    m_list_changed = true;
+    m_rebuild_pending = false;
+}
+
 void DC_Surface_Helper::compile()
 {
-    Easy_Object surface_data = m_surface_obj.get("data");
+    // compile() runs every frame, so the names are resolved only once
+    static const Easy_Key data_key("data"), context_key("context");
+    if (m_rebuild_pending || !m_display_list_generation || m_surface_obj.changed_since(m_display_list_generation)) {
+        rebuild_display_list();
+    }
+    // tracked changes show up as a rebuilt list; call commands and invalidated
+    // areas are redrawn regardless, tracking cannot tell whether they changed
+    Draw_Rect pending = draw_rect_union(m_invalid, m_display_list.call_bounds());
+    if (m_drawn && !m_list_changed && draw_rect_is_empty(pending)) {
+        m_update_stats.skipped_frames++;
+        return;
+    }
+
+    // the surface keeps what was drawn before, so only the damage is redrawn; the
+    // first update must cover all of it, and without the size nothing can be clipped
+    bool full = !m_drawn || m_size.cx <= 0 || m_size.cy <= 0;
+    RECT update = {0, 0, m_size.cx, m_size.cy};
+    if (!full) {
+        Draw_Rect damage = pending;
+        if (m_list_changed) damage = draw_rect_union(damage, m_display_list.damage_since(m_drawn_list));
+        damage = draw_rect_intersection(damage, {0.0f, 0.0f, (float)m_size.cx, (float)m_size.cy});
+        if (draw_rect_is_empty(damage)) {
+            m_drawn_list = m_display_list;
+            m_list_changed = false;
+            m_invalid = {0, 0, 0, 0};
+            m_update_stats.skipped_frames++;
+            return;
+        }
+        // whole pixels, antialiased edges included
+        update = {(LONG)floorf(damage.left), (LONG)floorf(damage.top), (LONG)ceilf(damage.right), (LONG)ceilf(damage.bottom)};
+    }
+
+    // borrowed views, the surface object keeps everything alive while drawing
+    Easy_Object_Ref surface_obj = m_surface_obj;
+    Easy_Object_Ref surface_data = surface_obj.get(data_key);
     CComPtr<ID2D1DeviceContext> d2dContext;
-    m_surface_obj.get("context").get_COM_interface(d2dContext);
+    surface_obj.get(context_key).get_COM_interface(d2dContext);
+    if (!m_resources.is<D2D_Context_Resources>()) {
+        // a surface made without an environment has a cache of its own
+        m_resources = make_resources(d2dContext);
+    }
     CComPtr<IDCompositionSurface> surface;
     surface_data.get_COM_interface(surface);
 
     CComPtr<IDXGISurface> dxgiSurface;
     POINT offset = {0, 0};
-    HRESULT hr = surface->BeginDraw(NULL, IID_PPV_ARGS(&dxgiSurface), &offset);
+    HRESULT hr = surface->BeginDraw(full ? NULL : &update, IID_PPV_ARGS(&dxgiSurface), &offset);
     if (FAILED(hr)) return;
 
     // 1. 获取表面描述
@@ -58,19 +253,52 @@ void DC_Surface_Helper::compile()
         &bitmapProperties, 
         &d2dTargetBitmap
     );
-    if (FAILED(hr)) return;
+    if (FAILED(hr)) {
+        surface->EndDraw();
+        return;
+    }
     d2dContext->SetTarget(d2dTargetBitmap);
 
+    // offset is where update's corner lands in the target, which may be an atlas
+    // shared with other surfaces, so clearing and drawing stay inside the update
+    LONG width = update.right - update.left, height = update.bottom - update.top;
+    bool clipped = m_size.cx > 0 && m_size.cy > 0;
+    if (!clipped) {
+        width = (LONG)surfaceDesc.Width;
+        height = (LONG)surfaceDesc.Height;
+    }
     d2dContext->BeginDraw();
+    if (clipped) {
+        d2dContext->PushAxisAlignedClip(D2D1::RectF((float)offset.x, (float)offset.y,
+            (float)(offset.x + width), (float)(offset.y + height)), D2D1_ANTIALIAS_MODE_ALIASED);
+    }
     d2dContext->Clear(D2D1::ColorF(0, 0, 0, 0));
-    Easy_Object components = m_surface_obj.get("components");
-    Map_Data *map_data = components.get_map_data();
-    for (auto &pair : *map_data) {
-        Easy_Object component = pair.second;
-        Component_Draw_Function draw_func = *((Component_Draw_Function*)component.get("draw_func").get_data_ptr());
-        void *data = component.get("data").get_data_ptr();
-        draw_func(data, d2dContext, offset);
+    D2D_Context_Resources *resources = m_resources.borrow().data_as<D2D_Context_Resources>();
+    D2D_Draw_Context draw_context(d2dContext, {offset.x - update.left, offset.y - update.top}, resources->cache);
+    current_cache = &resources->cache;
+    size_t replayed;
+    if (full) {
+        m_batched_list.replay(draw_context);
+        replayed = m_batched_list.command_count();
+    }
+    else {
+        // everything touching the cleared pixels, not just what changed
+        replayed = m_batched_list.replay(draw_context,
+            {(float)update.left, (float)update.top, (float)update.right, (float)update.bottom});
     }
+    current_cache = nullptr;
+    if (clipped) d2dContext->PopAxisAlignedClip();
     d2dContext->EndDraw();
     surface->EndDraw();
+
+    m_drawn_list = m_display_list;
+    m_drawn = true;
+    m_list_changed = false;
+    m_invalid = {0, 0, 0, 0};
+    uint64_t pixels = (uint64_t)width * (uint64_t)height;
+    m_update_stats.frames++;
+    if (full) m_update_stats.full_redraws++;
+    m_update_stats.pixels_redrawn += pixels;
+    m_update_stats.last_pixels_redrawn = pixels;
+    m_update_stats.last_commands_replayed = replayed;
 }
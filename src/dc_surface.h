@@ -9,9 +9,12 @@
  *
  * Features:
  * - Rectangle rendering with customizable colors
+ * - Brushes shared through a per-device-context LRU cache
  * - Custom drawing component support
  * - Component management (add, remove, clear)
- * - Surface compilation and rendering
+ * - Surface compilation into a display list, replayed every frame
+ * - Incremental updates that redraw only the damaged part of the surface
+ * - Same-color rects batched into one submission
  */
 
 #pragma once
@@ -22,12 +25,24 @@
 #include <string>
 #include <atlcomcli.h>
 #include "obj_helper.h"
+#include "obj_component_table.h"
+#include "dc_display_list.h"
+#include "dc_resource_cache.h"
 
 typedef struct s_Rect_Data {
     float x, y, width, height;
     D2D1_COLOR_F color;
 } Rect_Data;
 
+struct Surface_Update_Stats {
+    uint64_t frames;                // compile() calls that drew something
+    uint64_t skipped_frames;        // compile() calls with nothing to redraw
+    uint64_t full_redraws;
+    uint64_t pixels_redrawn;        // over all frames
+    uint64_t last_pixels_redrawn;   // in the last frame drawn
+    size_t last_commands_replayed;  // draw calls, batches counting once
+};
+
 typedef void (*Component_Draw_Function)(void* data, ID2D1DeviceContext* render_target, POINT offset);
 
 class DC_Surface_Helper {
@@ -37,12 +52,76 @@ public:
         if (surface_obj.get("components").is_null()) {
             surface_obj.insert("components", Easy_Object::make_map());
         }
+        static const bool rect_registered = (struct_register<Rect_Data>(U"rect_data", {
+            EDC_STRUCT_FIELD(Rect_Data, x), EDC_STRUCT_FIELD(Rect_Data, y),
+            EDC_STRUCT_FIELD(Rect_Data, width), EDC_STRUCT_FIELD(Rect_Data, height),
+            EDC_STRUCT_FIELD(Rect_Data, color)}), true);
+        (void)rect_registered;
+        m_rects = Component_Table<Rect_Data>(surface_obj.get("rects"));
+        if (m_rects.is_null()) {
+            m_rects = Component_Table<Rect_Data>::make();
+            surface_obj.insert("rects", m_rects.object());
+        }
+        // the display list is rebuilt only after something under the surface changed
+        m_surface_obj.track_changes();
+        m_resources = surface_obj.get("resources");
+        // without its size every update redraws the whole surface
+        Easy_Object size = surface_obj.get("size");
+        if (!size.is_null()) m_size = *(const SIZE*)size.get_data_ptr();
     }
     ~DC_Surface_Helper() {}
 
+    // a named component of its own: a map with a copy of the data and a draw function
     void addRect(const std::string &name, Rect_Data rect_data);
+    // a row in the surface's rect table, drawn before the named components
+    Component_Handle addRect(const Rect_Data &rect_data) {return m_rects.add(rect_data);}
+    bool removeRect(Component_Handle handle) {return m_rects.remove(handle);}
+    // for bulk edits down its columns, followed by rects().mark_changed()
+    Component_Table<Rect_Data> &rects() {return m_rects;}
 
+    // redraws what changed since the last call: what change tracking saw, the
+    // area of components with their own draw function, which may draw
+    // something new every frame, and whatever was invalidated. Nothing else
+    // is redrawn, so an unchanged surface costs no drawing at all
     void compile();
+    // for changes tracking cannot see, such as writes through get_data_ptr()
+    // or through a table column: the display list is rebuilt on the next
+    // compile() and, without a rect, the whole surface redrawn
+    void invalidate() {m_rebuild_pending = true; m_invalid = draw_rect_unbounded;}
+    void invalidate(const Draw_Rect &rect) {m_rebuild_pending = true; m_invalid = draw_rect_union(m_invalid, rect);}
+    // one command per component, what damage is computed on
+    const Display_List &display_list() const {return m_display_list;}
+    // the same with same-color rects batched, what compile() replays
+    const Display_List &batched_display_list() const {return m_batched_list;}
+    const Display_List_Batch_Stats &batch_stats() const {return m_batch_stats;}
+    const Surface_Update_Stats &update_stats() const {return m_update_stats;}
+    void reset_update_stats() {m_update_stats = {};}
+
+    static constexpr size_t resource_cache_capacity = 256;
+    // the brushes built-in components draw with, one cache per device context,
+    // made by whoever owns the context and handed to its surfaces as their
+    // "resources" entry. Used by one thread at a time, like the context
+    static Easy_Object make_resources(ID2D1DeviceContext *context);
+    // releases the cached resources and the context, before the device goes away
+    static void release_resources(const Easy_Object &resources);
+    // the cache of the surface compile() is drawing, for custom draw functions;
+    // nullptr outside of compile() and on other threads
+    static Draw_Resource_Cache *current_resources();
 private:
+    void rebuild_display_list();
+
     Easy_Object m_surface_obj;
+    Easy_Object m_resources;
+    Component_Table<Rect_Data> m_rects;
+    Display_List m_display_list;
+    Display_List m_batched_list;
+    Display_List_Batch_Stats m_batch_stats = {};
+    Display_List m_drawn_list;          // what the surface holds now, diffed against m_display_list
+    uint64_t m_display_list_generation = 0;
+    bool m_drawn = false;               // the first update must cover the whole surface
+    bool m_list_changed = false;        // rebuilt since m_drawn_list was drawn
+    bool m_rebuild_pending = false;
+    Draw_Rect m_invalid = {0, 0, 0, 0};
+    SIZE m_size = {0, 0};
+    Surface_Update_Stats m_update_stats = {};
 };
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "obj_component_table.h"
+#include <cassert>
+#include <cstring>
+
+Component_Table_Data::Component_Table_Data(const std::vector<Struct_Field> &fields, Object *row_type)
+    : m_fields(fields), m_columns(fields.size()), m_row_type(row_type)
+{
+}
+
+Easy_Object Component_Table_Data::make_object(const std::vector<Struct_Field> &fields, Object *row_type)
+{
+    if (!Easy_Type_Handle<Component_Table_Data>::type) {
+        Easy_Object::type_register<Component_Table_Data>(U"component_table");
+    }
+    Object *obj = obj_create(sizeof(Component_Table_Data), alignof(Component_Table_Data));
+    obj_debug_add_tag(obj, U"component_table");
+    new (obj->data) Component_Table_Data(fields, row_type);
+    obj_set_type(obj, Easy_Type_Handle<Component_Table_Data>::type);
+    return Easy_Object(obj);
+}
+
+void Component_Table_Data::reserve(size_t rows)
+{
+    for (size_t i = 0; i < m_fields.size(); i++) {
+        m_columns[i].reserve(rows * m_fields[i].size);
+    }
+    m_row_slots.reserve(rows);
+    m_slots.reserve(rows);
+}
+
+Component_Handle Component_Table_Data::add(const void *row)
+{
+    uint32_t slot = m_free_slot;
+    if (slot == UINT32_MAX) {
+        slot = (uint32_t)m_slots.size();
+        m_slots.push_back({0, 0});
+    }
+    else {
+        m_free_slot = m_slots[slot].row;
+    }
+    m_slots[slot].row = (uint32_t)m_row_slots.size();
+    m_row_slots.push_back(slot);
+    const unsigned char *bytes = (const unsigned char*)row;
+    for (size_t i = 0; i < m_fields.size(); i++) {
+        const Struct_Field &field = m_fields[i];
+        m_columns[i].insert(m_columns[i].end(), bytes + field.offset, bytes + field.offset + field.size);
+    }
+    return {slot, m_slots[slot].generation};
+}
+
+bool Component_Table_Data::remove(Component_Handle handle)
+{
+    size_t row = find(handle);
+    if (row == SIZE_MAX) return false;
+    size_t last = m_row_slots.size() - 1;
+    // the last row moves into the hole, so columns stay dense
+    for (size_t i = 0; i < m_fields.size(); i++) {
+        size_t size = m_fields[i].size;
+        unsigned char *column = m_columns[i].data();
+        if (row != last) memcpy(column + row * size, column + last * size, size);
+        m_columns[i].resize(last * size);
+    }
+    uint32_t moved_slot = m_row_slots[last];
+    m_row_slots[row] = moved_slot;
+    m_slots[moved_slot].row = (uint32_t)row;
+    m_row_slots.pop_back();
+    Slot &slot = m_slots[handle.slot];
+    slot.generation++;
+    slot.row = m_free_slot;
+    m_free_slot = handle.slot;
+    return true;
+}
+
+void Component_Table_Data::clear()
+{
+    for (size_t row = m_row_slots.size(); row > 0; row--) {
+        uint32_t slot = m_row_slots[row - 1];
+        m_slots[slot].generation++;
+        m_slots[slot].row = m_free_slot;
+        m_free_slot = slot;
+    }
+    m_row_slots.clear();
+    for (auto &column : m_columns) column.clear();
+}
+
+size_t Component_Table_Data::find(Component_Handle handle) const
+{
+    if (handle.slot >= m_slots.size()) return SIZE_MAX;
+    const Slot &slot = m_slots[handle.slot];
+    if (slot.generation != handle.generation) return SIZE_MAX;
+    // a free slot's row links the free list, it only names a row that points back at it
+    if (slot.row >= m_row_slots.size() || m_row_slots[slot.row] != handle.slot) return SIZE_MAX;
+    return slot.row;
+}
+
+Component_Handle Component_Table_Data::handle_at(size_t row) const
+{
+    assert(row < m_row_slots.size());
+    uint32_t slot = m_row_slots[row];
+    return {slot, m_slots[slot].generation};
+}
+
+void Component_Table_Data::read(size_t row, void *out) const
+{
+    unsigned char *bytes = (unsigned char*)out;
+    for (size_t i = 0; i < m_fields.size(); i++) {
+        const Struct_Field &field = m_fields[i];
+        memcpy(bytes + field.offset, m_columns[i].data() + row * field.size, field.size);
+    }
+}
+
+void Component_Table_Data::write(size_t row, const void *data)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < m_fields.size(); i++) {
+        const Struct_Field &field = m_fields[i];
+        memcpy(m_columns[i].data() + row * field.size, bytes + field.offset, field.size);
+    }
+}
+
+size_t Component_Table_Data::field_at(size_t offset, size_t size) const
+{
+    for (size_t i = 0; i < m_fields.size(); i++) {
+        if (m_fields[i].offset == offset && m_fields[i].size == size) return i;
+    }
+    return SIZE_MAX;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file obj_component_table.h
+ * @brief Columnar Tables of Registered Struct Types
+ * @version 1.0.0
+ *
+ * A struct registered with struct_register<T>() can be stored one instance
+ * per object, like any type_register<T>() type, or many rows at a time in a
+ * component table. The table is a single object keeping each field in its
+ * own contiguous column, so a pass over one field of every row is a linear
+ * scan:
+ *
+ * ```cpp
+ * struct_register<Rect_Data>(U"rect", {EDC_STRUCT_FIELD(Rect_Data, x), EDC_STRUCT_FIELD(Rect_Data, y)});
+ * auto rects = Component_Table<Rect_Data>::make();
+ * Component_Handle handle = rects.add(rect);
+ * for (float &x : rects.column(&Rect_Data::x)) x += 1;
+ * rects.mark_changed();    // column writes are not seen by change tracking
+ * ```
+ *
+ * Rows stay dense: removing one moves the last row into its place. Handles
+ * keep naming the same row through a generation-checked slot index, and a
+ * handle of a removed row is never valid again.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "obj_helper.h"
+
+// one field of a registered struct type, a column of its own in a table
+struct Struct_Field {
+    const char *name;
+    size_t offset;
+    size_t size;
+};
+
+#define EDC_STRUCT_FIELD(type, member) Struct_Field{#member, offsetof(type, member), sizeof(((type*)nullptr)->member)}
+
+// the fields struct_register<T>() was given, empty until then
+template<typename T>
+struct Easy_Struct_Schema {
+    static inline std::vector<Struct_Field> fields;
+};
+
+struct Component_Handle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool is_null() const {return slot == UINT32_MAX;}
+    bool operator==(const Component_Handle &other) const = default;
+};
+
+// the untyped table behind Component_Table<T>, rows are raw bytes of the struct
+class Component_Table_Data {
+public:
+    Component_Table_Data(const std::vector<Struct_Field> &fields, Object *row_type);
+
+    // a new table object holding rows of row_type laid out as fields
+    static Easy_Object make_object(const std::vector<Struct_Field> &fields, Object *row_type);
+
+    Object *row_type() const {return m_row_type;}
+    size_t size() const {return m_row_slots.size();}
+    void reserve(size_t rows);
+
+    Component_Handle add(const void *row);
+    bool remove(Component_Handle handle);
+    void clear();
+    // the dense row a handle names, SIZE_MAX once it was removed
+    size_t find(Component_Handle handle) const;
+    Component_Handle handle_at(size_t row) const;
+    void read(size_t row, void *out) const;
+    void write(size_t row, const void *data);
+    // the field starting at offset, SIZE_MAX if none does
+    size_t field_at(size_t offset, size_t size) const;
+    // field's values, one per dense row; moves when rows are added or reserved
+    void *column(size_t field) const {return (void*)m_columns[field].data();}
+
+private:
+    struct Slot {
+        uint32_t row;           // dense row while live, next free slot otherwise
+        uint32_t generation;    // bumped whenever the slot's row is removed
+    };
+
+    std::vector<Struct_Field> m_fields;
+    std::vector<std::vector<unsigned char>> m_columns;
+    std::vector<uint32_t> m_row_slots;  // the slot naming each dense row
+    std::vector<Slot> m_slots;
+    uint32_t m_free_slot = UINT32_MAX;
+    Object *m_row_type;
+};
+
+// registers T as a type, as type_register<T>() does, and records the fields
+// its component tables store as columns. T must be trivially copyable;
+// members left out of fields are not stored in tables
+template<typename T>
+inline Easy_Object struct_register(char32_t const* name, std::initializer_list<Struct_Field> fields)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "table rows are copied as raw bytes");
+    Easy_Struct_Schema<T>::fields.assign(fields);
+    return Easy_Object::type_register<T>(name);
+}
+
+// a component table object whose rows are T, see Component_Table_Data
+template<typename T>
+class Component_Table {
+public:
+    Component_Table() = default;
+    // null unless object is a table of T rows
+    explicit Component_Table(Easy_Object object) : m_table(object.as<Component_Table_Data>())
+    {
+        if (!m_table.is_null() && m_table->row_type() != Easy_Type_Handle<T>::type) m_table = {};
+    }
+
+    static Component_Table make()
+    {
+        assert(Easy_Type_Handle<T>::type && "struct_register<T>() the row type first");
+        return Component_Table(Component_Table_Data::make_object(Easy_Struct_Schema<T>::fields, Easy_Type_Handle<T>::type));
+    }
+
+    bool is_null() const {return m_table.is_null();}
+    const Easy_Object &object() const {return m_table.object();}
+
+    size_t size() const {return m_table->size();}
+    void reserve(size_t rows) {m_table->reserve(rows);}
+    Component_Handle add(const T &row)
+    {
+        Component_Handle handle = m_table->add(&row);
+        changed();
+        return handle;
+    }
+    bool remove(Component_Handle handle)
+    {
+        if (!m_table->remove(handle)) return false;
+        changed();
+        return true;
+    }
+    void clear()
+    {
+        m_table->clear();
+        changed();
+    }
+    bool contains(Component_Handle handle) const {return m_table->find(handle) != SIZE_MAX;}
+    Component_Handle handle_at(size_t row) const {return m_table->handle_at(row);}
+
+    // gathers the row from its columns; false if the handle's row was removed
+    bool get(Component_Handle handle, T &out) const
+    {
+        size_t row = m_table->find(handle);
+        if (row == SIZE_MAX) return false;
+        m_table->read(row, &out);
+        return true;
+    }
+
+    bool set(Component_Handle handle, const T &value)
+    {
+        size_t row = m_table->find(handle);
+        if (row == SIZE_MAX) return false;
+        m_table->write(row, &value);
+        changed();
+        return true;
+    }
+
+    // element i is the field of dense row i; invalidated by add, remove and
+    // reserve. Writes through it are not seen by change tracking, call
+    // mark_changed() once they are done
+    template<typename F>
+    std::span<F> column(F T::*member) const
+    {
+        alignas(T) unsigned char probe[sizeof(T)] = {};
+        const T *base = reinterpret_cast<const T*>(probe);
+        size_t offset = (size_t)(reinterpret_cast<const unsigned char*>(&(base->*member)) - probe);
+        size_t field = m_table->field_at(offset, sizeof(F));
+        assert(field != SIZE_MAX && "the member was not registered as a field");
+        if (field == SIZE_MAX) return {};
+        return std::span<F>(static_cast<F*>(m_table->column(field)), size());
+    }
+
+    // notes writes made through column() to change tracking, so observers of
+    // the table, a surface among them, see them
+    void mark_changed() {changed();}
+
+private:
+    // a table inside a tracked container is tracked, see Easy_Object::track_changes()
+    void changed()
+    {
+        Object *obj = m_table.object().get_ptr();
+        if (obj->change_tracked) obj_note_change(obj);
+    }
+
+    Typed_Object<Component_Table_Data> m_table;
+};
@@ -1,15 +1,18 @@
 #include "obj_helper.h"
 #include "obj_tree.h"
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <type_traits>
 #include <vector>
 
 Easy_Object Easy_Object::root_obj = {};
 Easy_Object Easy_Object::types_obj = {};
 Easy_Object Easy_Object::map_type_obj = {};
 Easy_Object Easy_Object::array_type_obj = {};
-Object_Key Easy_Object::type_name_key;
-std::unordered_map<std::type_index, Easy_Object> Easy_Object::type_db;
 
 #ifndef _Alignof
 #define _Alignof alignof
@@ -23,10 +26,51 @@ static Object *make_map_internal()
     return obj;
 }
 
+// change tracking hooks, a pointer check unless the container is tracked
+
+// links everything root holds, and what each newly tracked container holds in turn
+static void track_children(Object *root)
+{
+    std::vector<Object*> pending{root};
+    while (!pending.empty()) {
+        Object *container = pending.back();
+        pending.pop_back();
+        Easy_Object_Ref ref(container);
+        if (ref.is_map()) {
+            for (auto &pair : *ref.get_map_data()) {
+                if (obj_track_link(container, pair.second)) pending.push_back(pair.second);
+            }
+        }
+        else if (ref.is_array()) {
+            for (Object *child : ref.items()) {
+                if (obj_track_link(container, child)) pending.push_back(child);
+            }
+        }
+    }
+}
+
+static void track_added(Object *container, Object *child)
+{
+    if (container->change_tracked && obj_track_link(container, child)) track_children(child);
+}
+
+// before the container drops its reference, child may not outlive it
+static void track_removed(Object *container, Object *child)
+{
+    if (container->change_tracked) obj_track_unlink(container, child);
+}
+
+static void track_changed(Object *container)
+{
+    if (container->change_tracked) obj_note_change(container);
+}
+
 static void destruct_map(Closure_Data *self, Object *obj)
 {
+    Easy_Object::note_mutation();
     Map_Data *map = (Map_Data*)obj->data;
     for (auto &pair : *map) {
+        track_removed(obj, pair.second);
         obj_dec_ref(pair.second);
     }
     if (obj->data_size) delete map;
@@ -35,9 +79,11 @@ static void destruct_map(Closure_Data *self, Object *obj)
 
 static void destruct_array(Closure_Data *self, Object* obj)
 {
+    Easy_Object::note_mutation();
     Vector_Data *vec = (Vector_Data*)obj->data;
-    for (auto &obj : *vec) {
-        obj_dec_ref(obj);
+    for (Object *child : *vec) {
+        track_removed(obj, child);
+        obj_dec_ref(child);
     }
     if (obj->data_size) delete vec;
     else vec->~Vector_Data();
@@ -56,6 +102,9 @@ void Easy_Object::TypeSystemInit()
     Object *char32_string_type_obj = obj_get_char32_string_type();
     types_map->insert(std::make_pair("char32_string", char32_string_type_obj));
     obj_inc_ref(char32_string_type_obj);//TODO add typemap
+    Object *compact_string_type_obj = obj_get_compact_string_type();
+    types_map->insert(std::make_pair("compact_string", compact_string_type_obj));
+    obj_inc_ref(compact_string_type_obj);
 
     map_type_obj = make_map_internal();
     map_type_obj.set_type(map_type_obj);
@@ -75,9 +124,11 @@ void Easy_Object::TypeSystemInit()
 
     Object *destruct_array_obj = obj_create(sizeof(Closure_Data), _Alignof(Closure_Data));
     ((Closure_Data*)destruct_array_obj->data)->func = (void*)destruct_array;
-    obj_add_attr(array_type_obj.get_ptr(), OBJ_DESTRUCT_FUNCTION_KEY, destruct_map_obj);
+    obj_add_attr(array_type_obj.get_ptr(), OBJ_DESTRUCT_FUNCTION_KEY, destruct_array_obj);
 
-    type_name_key = obj_attr_hash_string(U"@object.type_name");
+    bool static_keys_ok = Static_Key_Registry::verify();
+    assert(static_keys_ok && "a compile-time key collided with an interned one");
+    (void)static_keys_ok;
     //type_base_key = obj_attr_hash_string(U"@object.type_base");
     //type_base_offset_key = obj_attr_hash_string(U"@object.base_offset");
     Easy_Object::type_register<IUnknown_Packer>(U"COM_IUnknown");
@@ -105,6 +156,11 @@ Easy_Object Easy_Object::make_char32_string(const char32_t *str)
     return Easy_Object(obj);
 }
 
+Easy_Object Easy_Object::make_compact_string(const char32_t *str)
+{
+    return Easy_Object(obj_create_compact_string(str));
+}
+
 Easy_Object Easy_Object::make_raw(void *data_orig, size_t copy_size, size_t align_req)
 {
     Object *obj = obj_create(copy_size, align_req);
@@ -117,91 +173,453 @@ Easy_Object Easy_Object::pack_COM_object(IUnknown *obj)
     Object *com_obj = obj_create(sizeof(IUnknown*), alignof(IUnknown*));
     *(IUnknown**)com_obj->data = obj;
     obj->AddRef();
-    obj_set_type(com_obj, type_db[std::type_index(typeid(IUnknown_Packer))].get_ptr());
+    obj_set_type(com_obj, Easy_Type_Handle<IUnknown_Packer>::type);
     return Easy_Object(com_obj);
 }
 
-bool Easy_Object::insert(const std::string &key, const Easy_Object &value)
+static Easy_Object make_size_value(size_t value)
 {
-    if (!obj) return false;
-    assert(obj_get_type(obj) == map_type_obj.get_ptr());
-    Map_Data *map = (Map_Data*)obj->data;
-    auto res = map->insert(std::make_pair(key, value.get_ptr()));
-    if (res.second) {
-        obj_inc_ref(value.get_ptr());
+    return Easy_Object::make_raw(&value, sizeof(value), alignof(size_t));
+}
+
+static Easy_Object make_census_counters(const Obj_Census_Counters &counters)
+{
+    Easy_Object result = Easy_Object::make_map();
+    result.insert("live_count", make_size_value(counters.live_count));
+    result.insert("live_bytes", make_size_value(counters.live_bytes));
+    result.insert("peak_count", make_size_value(counters.peak_count));
+    result.insert("peak_bytes", make_size_value(counters.peak_bytes));
+    result.insert("allocations", make_size_value(counters.allocations));
+    return result;
+}
+
+static std::string census_record_name(const Obj_Census_Record &record, const Map_Data *types_map)
+{
+    // registered types are known by the name they were registered under
+    if (record.type && types_map) {
+        for (auto &pair : *types_map) {
+            if (pair.second == record.type) return pair.first;
+        }
+    }
+    std::string name = "?";
+    if (record.name) {
+        char *utf8_name = obj_str32_to_utf8(record.name);
+        if (utf8_name) name = utf8_name;
+        free(utf8_name);
     }
-    return res.second;
+    if (record.type) {
+        char address[2 * sizeof(void*) + 4];
+        snprintf(address, sizeof(address), "@%p", record.type);
+        name += address;
+    }
+    return name;
 }
 
-Easy_Object Easy_Object::get(const std::string &key) const
+static Easy_Object make_census_records(size_t (*get_records)(Obj_Census_Record*, size_t), const Map_Data *types_map)
+{
+    std::vector<Obj_Census_Record> records(get_records(nullptr, 0));
+    records.resize(std::min(records.size(), get_records(records.data(), records.size())));
+    Easy_Object result = Easy_Object::make_map();
+    for (auto &record : records) {
+        result.insert(census_record_name(record, types_map), make_census_counters(record.counters));
+    }
+    return result;
+}
+
+Easy_Object Easy_Object::census_dump()
+{
+    Obj_Census_Totals totals = obj_get_census_totals();
+    const Map_Data *types_map = types_obj.is_null() ? nullptr : types_obj.get_map_data();
+    Easy_Object result = make_map();
+    Easy_Object totals_obj = make_census_counters(totals.objects);
+    totals_obj.insert("map_tables", make_size_value(totals.map_tables));
+    totals_obj.insert("map_slots", make_size_value(totals.map_slots));
+    totals_obj.insert("map_items", make_size_value(totals.map_items));
+    totals_obj.insert("map_bytes", make_size_value(totals.map_bytes));
+    uint64_t timestamp_ns = totals.timestamp_ns;
+    totals_obj.insert("timestamp_ns", make_raw(&timestamp_ns, sizeof(timestamp_ns), alignof(uint64_t)));
+    result.insert("totals", totals_obj);
+    result.insert("types", make_census_records(obj_get_census_types, types_map));
+    result.insert("tags", make_census_records(obj_get_census_tags, types_map));
+    return result;
+}
+
+// invalid sequences decode to U+FFFD
+static std::u32string utf8_to_u32(std::string_view str)
+{
+    std::u32string result;
+    result.reserve(str.size());
+    size_t i = 0;
+    while (i < str.size()) {
+        unsigned char lead = (unsigned char)str[i];
+        size_t extra = lead < 0x80 ? 0 : (lead >> 5) == 0x6 ? 1 : (lead >> 4) == 0xE ? 2 : (lead >> 3) == 0x1E ? 3 : SIZE_MAX;
+        if (extra == SIZE_MAX || extra >= str.size() - i) {
+            result.push_back(U'\uFFFD');
+            i++;
+            continue;
+        }
+        char32_t code = extra ? lead & (0x3F >> extra) : lead;
+        size_t j = 1;
+        for (; j <= extra; j++) {
+            unsigned char next = (unsigned char)str[i + j];
+            if ((next & 0xC0) != 0x80) break;
+            code = (code << 6) | (next & 0x3F);
+        }
+        if (j <= extra) {
+            result.push_back(U'\uFFFD');
+            i += j;
+            continue;
+        }
+        result.push_back(code);
+        i += extra + 1;
+    }
+    return result;
+}
+
+Easy_Key::Easy_Key(std::string_view name)
+    : m_name(name), m_map_hash(Map_Key_Hash()(name))
+{
+}
+
+Object_Key Easy_Key::key() const
+{
+    // racing threads intern the same name and store the same key
+    std::atomic_ref<Object_Key> cached(m_key);
+    Object_Key key = cached.load(std::memory_order_relaxed);
+    if (key) return key;
+    obj_init_key_map(); // a no-op once set up, lets static keys be used first
+    key = obj_attr_hash_string_pinned(utf8_to_u32(m_name).c_str());
+    cached.store(key, std::memory_order_relaxed);
+    return key;
+}
+
+static std::string_view map_key_name(std::string_view key) {return key;}
+static std::string_view map_key_name(const Easy_Key &key) {return key.name();}
+
+// the map_* helpers store value without touching its refcount, the caller
+// hands over a reference of its own or takes a new one on success
+
+template<typename Key>
+static bool map_insert(Object *obj, const Key &key, Object *value)
 {
-    if (!obj) return Easy_Object();
-    assert(obj_get_type(obj) == map_type_obj.get_ptr());
     Map_Data *map = (Map_Data*)obj->data;
+    if (map->find(key) != map->end()) return false;
+    Easy_Object::note_mutation();
+    map->emplace(std::string(map_key_name(key)), value);
+    track_added(obj, value);
+    track_changed(obj);
+    return true;
+}
+
+template<typename Key>
+static Object *map_get(const Map_Data *map, const Key &key)
+{
     auto it = map->find(key);
-    if (it == map->end()) return Easy_Object();
-    return Easy_Object(it->second);
+    return it == map->end() ? nullptr : it->second;
 }
 
-void Easy_Object::set(const std::string &key, const Easy_Object &value)
+template<typename Key>
+static void map_set(Object *obj, const Key &key, Object *value)
 {
-    if (!obj) return;
-    assert(obj_get_type(obj) == map_type_obj.get_ptr());
     Map_Data *map = (Map_Data*)obj->data;
     auto it = map->find(key);
     if (it == map->end()) {
-        insert(key, value);
+        map_insert(obj, key, value);
         return;
     }
+    Easy_Object::note_mutation();
+    track_removed(obj, it->second);
     obj_dec_ref(it->second);
-    it->second = value.get_ptr();
-    obj_inc_ref(value.get_ptr());
+    it->second = value;
+    track_added(obj, value);
+    track_changed(obj);
 }
 
-void Easy_Object::erase(const std::string &key)
+template<typename Key>
+static void map_erase(Object *obj, const Key &key)
 {
-    if (!obj) return;
-    assert(obj_get_type(obj) == map_type_obj.get_ptr());
     Map_Data *map = (Map_Data*)obj->data;
     auto it = map->find(key);
     if (it == map->end()) return;
+    Easy_Object::note_mutation();
+    track_removed(obj, it->second);
     obj_dec_ref(it->second);
     map->erase(it);
+    track_changed(obj);
+}
+
+Easy_Object_Ref Easy_Object_Ref::get(std::string_view key) const
+{
+    if (!obj) return Easy_Object_Ref();
+    assert(obj_get_type(obj) == Easy_Object::map_type_obj.get_ptr());
+    return Easy_Object_Ref(map_get(get_map_data(), key));
+}
+
+Easy_Object_Ref Easy_Object_Ref::get(const Easy_Key &key) const
+{
+    if (!obj) return Easy_Object_Ref();
+    assert(obj_get_type(obj) == Easy_Object::map_type_obj.get_ptr());
+    return Easy_Object_Ref(map_get(get_map_data(), key));
 }
 
-size_t Easy_Object::size() const
+Easy_Object_Ref Easy_Object_Ref::get(const Easy_Path &path) const
+{
+    return path.resolve(*this);
+}
+
+size_t Easy_Object_Ref::size() const
 {
     Object* obj_type = obj_get_type(obj);
-    if (obj_type == array_type_obj.get_ptr())
+    if (obj_type == Easy_Object::array_type_obj.get_ptr())
     {
         Vector_Data *vec = (Vector_Data*)obj->data;
         return vec->size();
     }
-    else if (obj_get_type(obj) == map_type_obj.get_ptr())
+    else if (obj_type == Easy_Object::map_type_obj.get_ptr())
     {
         return get_map_data()->size();
     }
     return 0;
 }
 
+Easy_Object_Ref Easy_Object_Ref::get(size_t index)const
+{
+    if (!obj) return Easy_Object_Ref();
+    assert(obj_get_type(obj) == Easy_Object::array_type_obj.get_ptr());
+    Vector_Data *vec = (Vector_Data*)obj->data;
+    if (index >= vec->size()) return Easy_Object_Ref();
+    return Easy_Object_Ref((*vec)[index]);
+}
+
+bool Easy_Object_Ref::is_map()const
+{
+    return obj && obj_get_type(obj) == Easy_Object::map_type_obj.get_ptr();
+}
+
+bool Easy_Object_Ref::is_array()const
+{
+    return obj && obj_get_type(obj) == Easy_Object::array_type_obj.get_ptr();
+}
+
+std::span<Object* const> Easy_Object_Ref::items()const
+{
+    if (!obj) return {};
+    assert(obj_get_type(obj) == Easy_Object::array_type_obj.get_ptr());
+    Vector_Data *vec = (Vector_Data*)obj->data;
+    return std::span<Object* const>(vec->data(), vec->size());
+}
+
+bool Easy_Object_Ref::has_COM_interface(const IID &iid)const
+{
+    if (!obj) return false;
+    if (!is_COM_object()) return false;
+    IUnknown *unk = *(IUnknown**)obj->data;
+    IUnknown *unk2;
+    if (unk->QueryInterface(iid, (void**)&unk2) == S_OK) {
+        unk2->Release();
+        return true;
+    }
+    return false;
+}
+
+bool Easy_Object::insert(std::string_view key, const Easy_Object &value)
+{
+    if (!obj) return false;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    if (!map_insert(obj, key, value.get_ptr())) return false;
+    obj_inc_ref(value.get_ptr());
+    return true;
+}
+
+bool Easy_Object::insert(std::string_view key, Easy_Object &&value)
+{
+    if (!obj) return false;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    if (!map_insert(obj, key, value.get_ptr())) return false;
+    value.release();
+    return true;
+}
+
+bool Easy_Object::insert(const Easy_Key &key, const Easy_Object &value)
+{
+    if (!obj) return false;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    if (!map_insert(obj, key, value.get_ptr())) return false;
+    obj_inc_ref(value.get_ptr());
+    return true;
+}
+
+bool Easy_Object::insert(const Easy_Key &key, Easy_Object &&value)
+{
+    if (!obj) return false;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    if (!map_insert(obj, key, value.get_ptr())) return false;
+    value.release();
+    return true;
+}
+
+Easy_Object Easy_Object::get(std::string_view key) const
+{
+    return Easy_Object(borrow().get(key));
+}
+
+Easy_Object Easy_Object::get(const Easy_Key &key) const
+{
+    return Easy_Object(borrow().get(key));
+}
+
+Easy_Object Easy_Object::get(const Easy_Path &path) const
+{
+    return Easy_Object(borrow().get(path));
+}
+
+// the step as an array index, SIZE_MAX unless it is all decimal digits
+static size_t path_step_index(std::string_view step)
+{
+    size_t index = 0;
+    for (char c : step) {
+        if (c < '0' || c > '9') return SIZE_MAX;
+        size_t digit = (size_t)(c - '0');
+        if (index > (SIZE_MAX - 1 - digit) / 10) return SIZE_MAX;
+        index = index * 10 + digit;
+    }
+    return index;
+}
+
+Easy_Path::Easy_Path(std::string_view path, bool cached) : m_cached(cached)
+{
+    while (!path.empty()) {
+        size_t end = path.find('/');
+        std::string_view step = path.substr(0, end);
+        // empty steps, as in a leading or doubled '/', are skipped
+        if (!step.empty()) m_steps.push_back({Easy_Key(step), path_step_index(step)});
+        if (end == std::string_view::npos) break;
+        path.remove_prefix(end + 1);
+    }
+    add_cache_use();
+}
+
+Easy_Path &Easy_Path::operator=(const Easy_Path &other)
+{
+    if (this == &other) return *this;
+    if (m_cached) Easy_Object::s_cached_paths.fetch_sub(1, std::memory_order_relaxed);
+    m_steps = other.m_steps;
+    m_cached = other.m_cached;
+    m_cache_root = m_cache_node = nullptr;
+    m_cache_epoch = 0;
+    add_cache_use();
+    return *this;
+}
+
+Easy_Object_Ref Easy_Path::resolve(Easy_Object_Ref root) const
+{
+    uint64_t epoch = Easy_Object::mutation_epoch();
+    if (m_cached && m_cache_root == root.get_ptr() && m_cache_epoch == epoch) {
+        return Easy_Object_Ref(m_cache_node);
+    }
+    Object *map_type = Easy_Object::map_type_obj.get_ptr();
+    Object *array_type = Easy_Object::array_type_obj.get_ptr();
+    Object *node = root.get_ptr();
+    for (const Step &step : m_steps) {
+        if (!node) break;
+        Object *type = obj_get_type(node);
+        if (type == array_type && step.index != SIZE_MAX) {
+            Vector_Data *vec = (Vector_Data*)node->data;
+            node = step.index < vec->size() ? (*vec)[step.index] : nullptr;
+        }
+        else if (type == map_type) {
+            node = map_get((Map_Data*)node->data, step.key);
+        }
+        else {
+            node = nullptr;
+        }
+    }
+    if (m_cached) {
+        m_cache_root = root.get_ptr();
+        m_cache_node = node;
+        m_cache_epoch = epoch;
+    }
+    return Easy_Object_Ref(node);
+}
+
+void Easy_Object::set(std::string_view key, const Easy_Object &value)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    obj_inc_ref(value.get_ptr());
+    map_set(obj, key, value.get_ptr());
+}
+
+void Easy_Object::set(std::string_view key, Easy_Object &&value)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    map_set(obj, key, value.release());
+}
+
+void Easy_Object::set(const Easy_Key &key, const Easy_Object &value)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    obj_inc_ref(value.get_ptr());
+    map_set(obj, key, value.get_ptr());
+}
+
+void Easy_Object::set(const Easy_Key &key, Easy_Object &&value)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    map_set(obj, key, value.release());
+}
+
+void Easy_Object::erase(std::string_view key)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    map_erase(obj, key);
+}
+
+void Easy_Object::erase(const Easy_Key &key)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    map_erase(obj, key);
+}
+
 Easy_Object Easy_Object::get(size_t index)const
 {
-    if (!obj) return Easy_Object();
-    assert(obj_get_type(obj) == array_type_obj.get_ptr());
+    return Easy_Object(borrow().get(index));
+}
+
+// takes over a reference the caller already owns
+static void array_set(Object *obj, size_t index, Object *value)
+{
     Vector_Data *vec = (Vector_Data*)obj->data;
-    if (index >= vec->size()) return Easy_Object();
-    return Easy_Object((*vec)[index]);
+    if (index >= vec->size()) {
+        obj_dec_ref(value);
+        return;
+    }
+    Easy_Object::note_mutation();
+    track_removed(obj, (*vec)[index]);
+    obj_dec_ref((*vec)[index]);
+    (*vec)[index] = value;
+    track_added(obj, value);
+    track_changed(obj);
 }
 
 void Easy_Object::set(size_t index, const Easy_Object &value)
 {
     if (!obj) return;
     assert(obj_get_type(obj) == array_type_obj.get_ptr());
-    Vector_Data *vec = (Vector_Data*)obj->data;
-    if (index >= vec->size()) return;
-    obj_dec_ref((*vec)[index]);
-    (*vec)[index] = value.get_ptr();
     obj_inc_ref(value.get_ptr());
+    array_set(obj, index, value.get_ptr());
+}
+
+void Easy_Object::set(size_t index, Easy_Object &&value)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == array_type_obj.get_ptr());
+    array_set(obj, index, value.release());
 }
 
 void Easy_Object::push_back(const Easy_Object &value)
@@ -209,35 +627,159 @@ void Easy_Object::push_back(const Easy_Object &value)
     if (!obj) return;
     assert(obj_get_type(obj) == array_type_obj.get_ptr());
     Vector_Data *vec = (Vector_Data*)obj->data;
+    note_mutation();
     vec->push_back(value.get_ptr());
     obj_inc_ref(value.get_ptr());
+    track_added(obj, value.get_ptr());
+    track_changed(obj);
 }
 
-void Easy_Object::erase(size_t index)
+void Easy_Object::push_back(Easy_Object &&value)
 {
     if (!obj) return;
     assert(obj_get_type(obj) == array_type_obj.get_ptr());
     Vector_Data *vec = (Vector_Data*)obj->data;
-    if (index >= vec->size()) return;
-    obj_dec_ref((*vec)[index]);
-    vec->erase(vec->begin() + index);
+    note_mutation();
+    vec->push_back(value.get_ptr());
+    track_added(obj, value.release());
+    track_changed(obj);
 }
 
-void Easy_Object::set_type(const Easy_Object &type)
+void Easy_Object::erase(size_t index)
 {
-    obj_set_type(obj, type.get_ptr());
+    erase(index, 1);
+}
+
+// an Easy_Object is exactly its Object*, so a span of them is read as the pointers
+static_assert(sizeof(Easy_Object) == sizeof(Object*) && std::is_standard_layout_v<Easy_Object>);
+
+static std::span<Object* const> object_ptrs(std::span<const Easy_Object> values)
+{
+    return std::span<Object* const>(reinterpret_cast<Object* const*>(values.data()), values.size());
 }
 
-bool Easy_Object::has_COM_interface(const IID &iid)const
+static bool array_insert(Object *obj, size_t index, std::span<Object* const> values)
+{
+    Vector_Data *vec = (Vector_Data*)obj->data;
+    if (index > vec->size()) return false;
+    Easy_Object::note_mutation();
+    obj_inc_refs(values.data(), values.size());
+    Object* const *data = vec->data();
+    if (std::less_equal<>()(data, values.data()) && std::less<>()(values.data(), data + vec->size())) {
+        // vector::insert may not read from the vector it grows
+        Vector_Data copy(values.begin(), values.end());
+        vec->insert(vec->begin() + index, copy.begin(), copy.end());
+    }
+    else {
+        vec->insert(vec->begin() + index, values.begin(), values.end());
+    }
+    if (obj->change_tracked) {
+        for (Object *value : values) track_added(obj, value);
+        obj_note_change(obj);
+    }
+    return true;
+}
+
+void Easy_Object::reserve(size_t capacity)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == array_type_obj.get_ptr());
+    ((Vector_Data*)obj->data)->reserve(capacity);
+}
+
+bool Easy_Object::insert(size_t index, std::span<const Easy_Object> values)
+{
+    return insert(index, object_ptrs(values));
+}
+
+bool Easy_Object::insert(size_t index, std::span<Object* const> values)
 {
     if (!obj) return false;
-    if (!is_COM_object()) return false;
-    IUnknown *unk = *(IUnknown**)obj->data;
-    IUnknown *unk2;
-    if (unk->QueryInterface(iid, (void**)&unk2) == S_OK) {
-        unk2->Release();
-        return true;
+    assert(obj_get_type(obj) == array_type_obj.get_ptr());
+    return array_insert(obj, index, values);
+}
+
+void Easy_Object::append(std::span<const Easy_Object> values)
+{
+    append(object_ptrs(values));
+}
+
+void Easy_Object::append(std::span<Object* const> values)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == array_type_obj.get_ptr());
+    array_insert(obj, ((Vector_Data*)obj->data)->size(), values);
+}
+
+void Easy_Object::erase(size_t first, size_t count)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == array_type_obj.get_ptr());
+    Vector_Data *vec = (Vector_Data*)obj->data;
+    if (first >= vec->size()) return;
+    count = std::min(count, vec->size() - first);
+    note_mutation();
+    // taken out first, so destructors that reach back into the array find it consistent
+    Vector_Data removed(vec->begin() + first, vec->begin() + first + count);
+    vec->erase(vec->begin() + first, vec->begin() + first + count);
+    if (obj->change_tracked) {
+        for (Object *value : removed) track_removed(obj, value);
     }
-    return false;
+    track_changed(obj);
+    obj_dec_refs(removed.data(), removed.size());
+}
+
+void Easy_Object::clear()
+{
+    if (!obj) return;
+    if (obj_get_type(obj) == array_type_obj.get_ptr()) {
+        erase(0, SIZE_MAX);
+        return;
+    }
+    assert(obj_get_type(obj) == map_type_obj.get_ptr());
+    Map_Data *map = get_map_data();
+    if (map->empty()) return;
+    note_mutation();
+    // emptied first, so destructors that reach back into the map find it consistent
+    Map_Data old;
+    old.swap(*map);
+    for (auto &pair : old) {
+        track_removed(obj, pair.second);
+        obj_dec_ref(pair.second);
+    }
+    track_changed(obj);
+}
+
+void Easy_Object::swap_remove(size_t index)
+{
+    if (!obj) return;
+    assert(obj_get_type(obj) == array_type_obj.get_ptr());
+    Vector_Data *vec = (Vector_Data*)obj->data;
+    if (index >= vec->size()) return;
+    note_mutation();
+    // taken out first, like erase()
+    Object *removed = (*vec)[index];
+    (*vec)[index] = vec->back();
+    vec->pop_back();
+    track_removed(obj, removed);
+    track_changed(obj);
+    obj_dec_ref(removed);
+}
+
+void Easy_Object::track_changes()
+{
+    if (!obj) return;
+    if (obj_track_changes(obj)) track_children(obj);
+}
+
+size_t Easy_Object::subscribe(Obj_Change_Callback callback, void *context)
+{
+    if (!obj) return 0;
+    track_changes();
+    return obj_subscribe(obj, callback, context);
 }
 
+void Easy_Object::set_type(const Easy_Object &type)
+{
+    obj_set_type(obj, type.get_ptr());
+}
@@ -18,9 +18,12 @@
 #pragma once
 
 #include <atlbase.h>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <typeinfo>
@@ -29,8 +32,42 @@
 #include <atlcomcli.h>
 
 #include "obj_tree.h"
+#include "obj_static_key.h"
 
-typedef std::unordered_map<std::string, Object*> Map_Data;
+// a map key or attribute name resolved once: keeps the hash Map_Data buckets
+// the name by, so lookups through it neither allocate nor rehash. Make keys
+// once (e.g. as statics), not per lookup
+class Easy_Key {
+public:
+    explicit Easy_Key(std::string_view name);
+
+    const std::string &name() const {return m_name;}
+    // the name as an attribute key, interned on the first call and pinned
+    // for the process lifetime; map lookups never need it
+    Object_Key key() const;
+    size_t map_hash() const {return m_map_hash;}
+
+private:
+    std::string m_name;
+    size_t m_map_hash;
+    mutable Object_Key m_key = 0; // 0 until key() interned the name
+};
+
+// lets Map_Data find std::string_view and Easy_Key keys without building a std::string
+struct Map_Key_Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const {return std::hash<std::string_view>()(key);}
+    size_t operator()(const Easy_Key &key) const {return key.map_hash();}
+};
+
+struct Map_Key_Equal {
+    using is_transparent = void;
+    bool operator()(std::string_view lhs, std::string_view rhs) const {return lhs == rhs;}
+    bool operator()(const Easy_Key &lhs, std::string_view rhs) const {return lhs.name() == rhs;}
+    bool operator()(std::string_view lhs, const Easy_Key &rhs) const {return lhs == rhs.name();}
+};
+
+typedef std::unordered_map<std::string, Object*, Map_Key_Hash, Map_Key_Equal> Map_Data;
 typedef std::vector<Object*> Vector_Data;
 
 class IUnknown_Packer
@@ -43,6 +80,68 @@ public:
 
 
 
+class Easy_Object;
+class Easy_Path;
+template<typename T> class Typed_Object;
+
+// the type object type_register<T>() created, cached per T so that type
+// checks are a pointer compare; NULL until T is registered
+template<typename T>
+struct Easy_Type_Handle {
+    static inline Object *type = nullptr;
+};
+
+// borrows an object without touching its refcount, for read-only traversal.
+// Only valid while something else holds a reference, such as the map or
+// array it was read from; make an Easy_Object from it to keep it longer
+class Easy_Object_Ref {
+public:
+    Easy_Object_Ref() = default;
+    Easy_Object_Ref(Object *obj) : obj(obj) {}
+    Easy_Object_Ref(const Easy_Object &owner);
+
+    Object *get_ptr() const {return obj;}
+    void *get_data_ptr() const {return obj->data;}
+    bool is_null() const {return obj == nullptr;}
+
+    Easy_Object_Ref get(std::string_view key) const;
+    Easy_Object_Ref get(const Easy_Key &key) const;
+    Easy_Object_Ref operator[](std::string_view key) const {return get(key);}
+    Easy_Object_Ref operator[](const Easy_Key &key) const {return get(key);}
+    // the node path leads to from here, null if any step is missing
+    Easy_Object_Ref get(const Easy_Path &path) const;
+
+    bool is_map()const;
+    bool is_array()const;
+
+    size_t size()const;
+    Easy_Object_Ref get(size_t index)const;
+    // the array's elements in place, borrowed; invalidated by any change to the array
+    std::span<Object* const> items()const;
+    Map_Data *get_map_data() const {return (Map_Data*)obj->data;}
+
+    // whether the object has T's registered type
+    template<typename T> bool is()const
+    {
+        Object *type = Easy_Type_Handle<T>::type;
+        return obj && type && obj_get_type(obj) == type;
+    }
+    // the object's data as a T, nullptr unless is<T>()
+    template<typename T> T *data_as()const {return is<T>() ? static_cast<T*>(obj->data) : nullptr;}
+
+    bool is_COM_object()const {return is<IUnknown_Packer>();}
+    bool has_COM_interface(const IID &iid)const;
+    template<typename T> HRESULT get_COM_interface(CComPtr<T> &result)const;
+
+    // see Easy_Object::track_changes(); untracked objects are never dirty and report generation 0
+    bool is_dirty()const {return obj_is_dirty(obj) != 0;}
+    uint64_t change_generation()const {return obj_change_generation(obj);}
+    bool changed_since(uint64_t generation)const {return change_generation() > generation;}
+
+private:
+    Object *obj = nullptr;
+};
+
 class Easy_Object {
 public:
     Easy_Object() = default;
@@ -53,6 +152,7 @@ public:
         }
     }
     Easy_Object(Object *obj) : obj(obj) {if (obj)obj_inc_ref(obj);}
+    Easy_Object(Easy_Object_Ref ref) : Easy_Object(ref.get_ptr()) {}
     Easy_Object(const Easy_Object &other) : obj(other.obj) {if (obj)obj_inc_ref(obj);}
     Easy_Object(Easy_Object &&other)noexcept : obj(other.obj) {other.obj = nullptr;}
     Easy_Object &operator=(const Easy_Object &other)
@@ -69,58 +169,206 @@ public:
         }
         return *this;
     }
+    Easy_Object &operator=(Easy_Object &&other)noexcept
+    {
+        if (this == &other) {
+            return *this;
+        }
+        Object *old = obj;
+        obj = other.obj;
+        other.obj = nullptr;
+        if (old) {
+            obj_dec_ref(old);
+        }
+        return *this;
+    }
 
     Object *get_ptr() const {return obj;}
     void *get_data_ptr() const {return obj->data;}
     bool is_null() const {return obj == nullptr;}
+    Easy_Object_Ref borrow() const {return Easy_Object_Ref(obj);}
+    // hands the reference over to the caller, leaving this handle null
+    Object *release() {Object *result = obj; obj = nullptr; return result;}
 
     static Easy_Object make_array();
     static Easy_Object make_map();
     static Easy_Object make_char32_string(const char32_t *str);
+    // same text semantics as make_char32_string, stored 1, 2 or 4 bytes per character
+    static Easy_Object make_compact_string(const char32_t *str);
     static Easy_Object make_raw(void *data_orig, size_t copy_size, size_t align_req);
     static Easy_Object pack_COM_object(IUnknown *obj);
     static void TypeSystemInit();
+    // map of "totals", "types" and "tags", each counter a raw size_t; see obj_set_census()
+    static Easy_Object census_dump();
     static inline Easy_Object get_root() { return root_obj; }
 
-    bool insert(const std::string &key, const Easy_Object &value);
-    Easy_Object get(const std::string &key) const;
-    void set(const std::string &key, const Easy_Object &value);
-    void erase(const std::string &key);
+    // the rvalue overloads move the caller's reference into the container;
+    // a failed insert leaves value untouched
+    bool insert(std::string_view key, const Easy_Object &value);
+    bool insert(std::string_view key, Easy_Object &&value);
+    Easy_Object get(std::string_view key) const;
+    void set(std::string_view key, const Easy_Object &value);
+    void set(std::string_view key, Easy_Object &&value);
+    void erase(std::string_view key);
+    // same as above, without hashing the name again; see Easy_Key
+    bool insert(const Easy_Key &key, const Easy_Object &value);
+    bool insert(const Easy_Key &key, Easy_Object &&value);
+    Easy_Object get(const Easy_Key &key) const;
+    void set(const Easy_Key &key, const Easy_Object &value);
+    void set(const Easy_Key &key, Easy_Object &&value);
+    void erase(const Easy_Key &key);
 
-    Easy_Object operator[](const std::string &key) const {return get(key);}
+    Easy_Object operator[](std::string_view key) const {return get(key);}
+    Easy_Object operator[](const Easy_Key &key) const {return get(key);}
+    Easy_Object get(const Easy_Path &path) const;
 
-    size_t size()const;
+    size_t size()const {return borrow().size();}
     Easy_Object get(size_t index)const;
     void set(size_t index, const Easy_Object &value);
+    void set(size_t index, Easy_Object &&value);
     void push_back(const Easy_Object &value);
+    void push_back(Easy_Object &&value);
     void erase(size_t index);
+    // bulk forms of the above: one type check and one refcount pass per call.
+    // values may come from this array's own items()
+    void reserve(size_t capacity);
+    bool insert(size_t index, std::span<const Easy_Object> values);
+    bool insert(size_t index, std::span<Object* const> values);
+    void append(std::span<const Easy_Object> values);
+    void append(std::span<Object* const> values);
+    // removes up to count elements starting at first
+    void erase(size_t first, size_t count);
+    // empties a map or an array
+    void clear();
+    // O(1) erase that moves the last element into index instead of keeping order
+    void swap_remove(size_t index);
+    std::span<Object* const> items()const {return borrow().items();}
     Map_Data *get_map_data() const {return (Map_Data*)obj->data;}
 
     template<typename T, typename Destructor = std::default_delete<T>>static Easy_Object type_register(char32_t const* name);
+    template<typename T> bool is()const {return borrow().is<T>();}
+    // a handle typed as T, null unless is<T>()
+    template<typename T> Typed_Object<T> as()const;
 
-    bool is_COM_object()const {return obj && obj_get_type(obj) == type_db[std::type_index(typeid(IUnknown_Packer))].get_ptr();}
-    bool has_COM_interface(const IID &iid)const;
-    template<typename T> HRESULT get_COM_interface(CComPtr<T> &result)const;
+    bool is_COM_object()const {return borrow().is_COM_object();}
+    bool has_COM_interface(const IID &iid)const {return borrow().has_COM_interface(iid);}
+    template<typename T> HRESULT get_COM_interface(CComPtr<T> &result)const {return borrow().get_COM_interface(result);}
+
+    // records changes to this map or array and every object it holds, down
+    // the tree: each change marks the changed container and all tracked
+    // containers above it dirty with a new generation, and calls their
+    // subscribers. Objects inserted into a tracked container are tracked too.
+    // A renderer keeps the generation it last drew and only descends into
+    // children that changed_since() it
+    void track_changes();
+    void clear_dirty() {obj_clear_dirty(obj);}
+    // tracks the object first; see obj_subscribe()
+    size_t subscribe(Obj_Change_Callback callback, void *context);
+    void unsubscribe(size_t subscription) {obj_unsubscribe(obj, subscription);}
+    bool is_dirty()const {return borrow().is_dirty();}
+    uint64_t change_generation()const {return borrow().change_generation();}
+    bool changed_since(uint64_t generation)const {return borrow().changed_since(generation);}
+    static uint64_t current_change_generation() {return obj_current_change_generation();}
 
+    // lets cached Easy_Paths tell their node went stale. While one exists it
+    // is bumped by insert, set, erase, push_back, the bulk insert and erase,
+    // clear and swap_remove on a map or array, and whenever a map or array
+    // is destroyed; with no cached path it stays put, so
+    // mutations cost nothing extra. Writes through get_map_data(), items(),
+    // spans, get_data_ptr() or the C map and object functions are not seen:
+    // call note_mutation() after them
+    static uint64_t mutation_epoch() {return s_mutation_epoch.load(std::memory_order_relaxed);}
+    static void note_mutation() {
+        if (s_cached_paths.load(std::memory_order_relaxed)) s_mutation_epoch.fetch_add(1, std::memory_order_relaxed);
+    }
 
 private:
+    friend class Easy_Object_Ref;
+    friend class Easy_Path;
+
     void set_type(const Easy_Object &type);
 
     Object *obj = nullptr;
     static Easy_Object root_obj, types_obj, map_type_obj, array_type_obj;
-    static std::unordered_map<std::type_index, Easy_Object> type_db;
+    static inline std::atomic<uint64_t> s_mutation_epoch{1};
+    static inline std::atomic<size_t> s_cached_paths{0};    // live Easy_Paths with a cache
+
+    static constexpr Object_Key type_name_key = EDC_KEY(U"@object.type_name");
+
+};
+
+inline Easy_Object_Ref::Easy_Object_Ref(const Easy_Object &owner) : obj(owner.get_ptr()) {}
+
+// a path such as "DirectComposition/root_visual/childs/3/surface" split on '/'
+// with each step's name hashed once, so resolving it neither allocates nor
+// hashes names. A numeric step indexes an array and names a map entry
+// otherwise. Make paths once (e.g. as statics), like Easy_Key.
+//
+// A cached path remembers the last node it resolved and hands it back until
+// Easy_Object::mutation_epoch() moves, which only happens while some cached
+// path exists; see there for the writes it misses. Not safe to resolve from
+// several threads at once
+class Easy_Path {
+public:
+    explicit Easy_Path(std::string_view path, bool cached = false);
+    Easy_Path(const Easy_Path &other) : m_steps(other.m_steps), m_cached(other.m_cached) {add_cache_use();}
+    Easy_Path &operator=(const Easy_Path &other);
+    ~Easy_Path() {if (m_cached) Easy_Object::s_cached_paths.fetch_sub(1, std::memory_order_relaxed);}
+
+    size_t size() const {return m_steps.size();}
+    Easy_Object_Ref resolve(Easy_Object_Ref root) const;
+
+private:
+    struct Step {
+        Easy_Key key;
+        size_t index;   // SIZE_MAX unless the step is a number
+    };
+
+    void add_cache_use() {if (m_cached) Easy_Object::s_cached_paths.fetch_add(1, std::memory_order_relaxed);}
+
+    std::vector<Step> m_steps;
+    bool m_cached;
+    mutable Object *m_cache_root = nullptr;
+    mutable Object *m_cache_node = nullptr;
+    mutable uint64_t m_cache_epoch = 0;
+};
+
+// an owning handle known to hold a T, checked once when it is made
+template<typename T>
+class Typed_Object {
+public:
+    Typed_Object() = default;
+    explicit Typed_Object(Easy_Object object) : m_object(object.is<T>() ? std::move(object) : Easy_Object()) {}
 
-    static Object_Key type_name_key;
+    bool is_null() const {return m_object.is_null();}
+    T *get() const {return is_null() ? nullptr : static_cast<T*>(m_object.get_data_ptr());}
+    T *operator->() const {return get();}
+    T &operator*() const {return *get();}
+    const Easy_Object &object() const {return m_object;}
 
+private:
+    Easy_Object m_object;
 };
 
+template<typename T>
+inline Typed_Object<T> Easy_Object::as()const
+{
+    return Typed_Object<T>(*this);
+}
+
 
 template<typename T, typename Destructor>
 inline Easy_Object Easy_Object::type_register(char32_t const* name)
 {
-    auto type_map = make_map();
     char* utf8_name = obj_str32_to_utf8(name);
     assert(utf8_name);
+    // a name is registered once, later calls get the first registration's type
+    Easy_Object registered = types_obj.get(utf8_name);
+    if (!registered.is_null()) {
+        free(utf8_name);
+        return registered;
+    }
+    auto type_map = make_map();
     Object* name_obj = obj_create_char32_string(name);
     Object_Destruct_Function func = [](struct s_Closure_Data* self, struct s_Object* obj)->void {
             if (obj->data_size)
@@ -131,17 +379,17 @@ inline Easy_Object Easy_Object::type_register(char32_t const* name)
             }
         };
     Object* destructor_obj = obj_create(sizeof(s_Closure_Data), alignof(Closure_Data));
-    destructor_obj->data = (void*)func;
+    ((Closure_Data*)destructor_obj->data)->func = (void*)func;
     obj_add_attr(type_map.get_ptr(), type_name_key, name_obj);
     obj_add_attr(type_map.get_ptr(), OBJ_DESTRUCT_FUNCTION_KEY, destructor_obj);
-    types_obj.insert(utf8_name, type_map);
-    type_db.insert(std::make_pair(std::type_index(typeid(T)), type_map));
+    // the handle must only ever point at a type types_obj keeps alive
+    if (types_obj.insert(utf8_name, type_map)) Easy_Type_Handle<T>::type = type_map.get_ptr();
     free(utf8_name);
     return type_map;
 }
 
 template<typename T>
-inline HRESULT Easy_Object::get_COM_interface(CComPtr<T> &result)const
+inline HRESULT Easy_Object_Ref::get_COM_interface(CComPtr<T> &result)const
 {
     if (!obj) return E_FAIL;
     if (!is_COM_object()) return E_FAIL;
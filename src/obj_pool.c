@@ -0,0 +1,181 @@
+#include "obj_pool.h"
+#include "obj_tree.h"
+#include "obj_sync.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// every block starts with a header recording its size class; it keeps the
+// returned pointer 16-byte aligned and is reused for the free-list links
+#define POOL_HEADER_SIZE 16
+#define POOL_LARGE_CLASS UINT32_MAX
+
+// block sizes including the header, multiples of POOL_HEADER_SIZE
+static const size_t pool_class_sizes[] = { 64, 96, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 1024 };
+#define POOL_CLASS_COUNT (sizeof(pool_class_sizes) / sizeof(pool_class_sizes[0]))
+
+typedef struct s_Pool_Block {
+    struct s_Pool_Block* next;
+    struct s_Pool_Block* next_batch;    // only meaningful on the first block of a batch
+    size_t batch_count;                 // only meaningful on the first block of a batch
+} Pool_Block;
+
+typedef struct s_Pool_Cache {
+    Pool_Block* head;
+    size_t count;
+} Pool_Cache;
+
+typedef struct s_Pool_Central {
+    Obj_Spin_Lock lock;
+    Pool_Block* batches;
+    size_t batch_count;
+    size_t slab_bytes;
+} Pool_Central;
+
+static OBJ_THREAD_LOCAL Pool_Cache pool_thread_cache[POOL_CLASS_COUNT];
+static Pool_Central pool_central[POOL_CLASS_COUNT];
+static Obj_Spin_Lock pool_large_lock;
+static size_t pool_large_allocations = 0;
+
+static uint32_t pool_size_class(size_t size) {
+    size_t block_size = size + POOL_HEADER_SIZE;
+    for (uint32_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        if (block_size <= pool_class_sizes[i]) return i;
+    }
+    return POOL_LARGE_CLASS;
+}
+
+static void pool_set_class(Pool_Block* block, uint32_t size_class) {
+    *(uint32_t*)block = size_class;
+}
+
+static uint32_t pool_get_class(const void* ptr) {
+    return *(const uint32_t*)((const char*)ptr - POOL_HEADER_SIZE);
+}
+
+static void pool_carve_slab(Pool_Cache* cache, uint32_t size_class) {
+    char* slab = (char*)malloc(OBJ_POOL_SLAB_SIZE);
+    if (!slab) return;
+    size_t block_size = pool_class_sizes[size_class];
+    // malloc only promises 8-byte alignment on 32-bit targets
+    char* begin = (char*)(((uintptr_t)slab + POOL_HEADER_SIZE - 1) & ~(uintptr_t)(POOL_HEADER_SIZE - 1));
+    size_t block_count = (size_t)(slab + OBJ_POOL_SLAB_SIZE - begin) / block_size;
+    for (size_t i = block_count; i > 0; i--) {
+        Pool_Block* block = (Pool_Block*)(begin + (i - 1) * block_size);
+        block->next = cache->head;
+        cache->head = block;
+    }
+    cache->count += block_count;
+
+    Pool_Central* central = &pool_central[size_class];
+    obj_spin_lock(&central->lock);
+    central->slab_bytes += OBJ_POOL_SLAB_SIZE;
+    obj_spin_unlock(&central->lock);
+}
+
+static void pool_refill(Pool_Cache* cache, uint32_t size_class) {
+    Pool_Central* central = &pool_central[size_class];
+    obj_spin_lock(&central->lock);
+    Pool_Block* batch = central->batches;
+    if (batch) {
+        central->batches = batch->next_batch;
+        central->batch_count--;
+    }
+    obj_spin_unlock(&central->lock);
+    if (!batch) {
+        pool_carve_slab(cache, size_class);
+        return;
+    }
+    cache->count = batch->batch_count;
+    cache->head = batch;
+}
+
+// detaches up to count blocks from the cache and parks them centrally as one batch
+static void pool_release_batch(Pool_Cache* cache, uint32_t size_class, size_t count) {
+    Pool_Block* batch = cache->head;
+    Pool_Block* last = batch;
+    for (size_t i = 1; i < count; i++) last = last->next;
+    cache->head = last->next;
+    cache->count -= count;
+    last->next = NULL;
+    batch->batch_count = count;
+
+    Pool_Central* central = &pool_central[size_class];
+    obj_spin_lock(&central->lock);
+    batch->next_batch = central->batches;
+    central->batches = batch;
+    central->batch_count++;
+    obj_spin_unlock(&central->lock);
+}
+
+void* obj_pool_allocate(size_t size) {
+    uint32_t size_class = pool_size_class(size);
+    Pool_Block* block;
+    if (size_class == POOL_LARGE_CLASS) {
+        block = (Pool_Block*)malloc(size + POOL_HEADER_SIZE);
+        if (!block) return NULL;
+        obj_spin_lock(&pool_large_lock);
+        pool_large_allocations++;
+        obj_spin_unlock(&pool_large_lock);
+    }
+    else {
+        Pool_Cache* cache = &pool_thread_cache[size_class];
+        if (!cache->head) pool_refill(cache, size_class);
+        block = cache->head;
+        if (!block) return NULL;
+        cache->head = block->next;
+        cache->count--;
+    }
+    pool_set_class(block, size_class);
+    return (char*)block + POOL_HEADER_SIZE;
+}
+
+void obj_pool_deallocate(void* ptr) {
+    if (!ptr) return;
+    uint32_t size_class = pool_get_class(ptr);
+    Pool_Block* block = (Pool_Block*)((char*)ptr - POOL_HEADER_SIZE);
+    if (size_class == POOL_LARGE_CLASS) {
+        obj_spin_lock(&pool_large_lock);
+        pool_large_allocations--;
+        obj_spin_unlock(&pool_large_lock);
+        free(block);
+        return;
+    }
+    assert(size_class < POOL_CLASS_COUNT);
+    Pool_Cache* cache = &pool_thread_cache[size_class];
+    block->next = cache->head;
+    cache->head = block;
+    cache->count++;
+    // keep one batch worth of headroom so alloc/free ping-pong stays local
+    if (cache->count >= 2 * OBJ_POOL_BATCH_SIZE) {
+        pool_release_batch(cache, size_class, OBJ_POOL_BATCH_SIZE);
+    }
+}
+
+void obj_pool_install() {
+    obj_debug_set_allocator(obj_pool_allocate, obj_pool_deallocate);
+}
+
+void obj_pool_thread_flush() {
+    for (uint32_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        Pool_Cache* cache = &pool_thread_cache[i];
+        while (cache->count) {
+            pool_release_batch(cache, i, cache->count < OBJ_POOL_BATCH_SIZE ? cache->count : OBJ_POOL_BATCH_SIZE);
+        }
+    }
+}
+
+Obj_Pool_Stats obj_pool_get_stats() {
+    Obj_Pool_Stats stats = { 0 };
+    for (uint32_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        Pool_Central* central = &pool_central[i];
+        obj_spin_lock(&central->lock);
+        stats.slab_bytes += central->slab_bytes;
+        stats.central_batches += central->batch_count;
+        obj_spin_unlock(&central->lock);
+    }
+    obj_spin_lock(&pool_large_lock);
+    stats.large_allocations = pool_large_allocations;
+    obj_spin_unlock(&pool_large_lock);
+    return stats;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file obj_static_key.h
+ * @brief Compile-Time Object Keys for String Literals
+ * @version 1.0.0
+ *
+ * Well-known attribute names can be hashed at compile time instead of going
+ * through obj_attr_hash_string() on every use:
+ *
+ * ```cpp
+ * constexpr Object_Key type_name_key = EDC_KEY(U"@object.type_name");
+ * obj_get_attr(obj, type_name_key);
+ * ```
+ *
+ * Interning normally bumps a key past hash collisions, which a compile-time
+ * value cannot know about. Every literal used through EDC_KEY therefore
+ * registers itself during static initialization, and
+ * Static_Key_Registry::verify() interns them all at startup and reports any
+ * literal whose runtime key differs from its compile-time one. The literals
+ * stay pinned in the intern table, see obj_sweep_interned_keys().
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "obj_tree.h"
+
+namespace obj_static_key_detail {
+
+constexpr uint64_t avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 29;
+    h *= 0x165667B19E3779F9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+constexpr uint64_t rotl(uint64_t value, int bits)
+{
+    return value << bits | value >> (64 - bits);
+}
+
+constexpr uint64_t short_round(uint64_t h, uint64_t lane)
+{
+    return rotl(h ^ (lane * 0xC2B2AE3D27D4EB4Full), 31) * 0x9E3779B185EBCA87ull;
+}
+
+}
+
+// constexpr twin of hash_char32_append() in obj_tree.c (the short rounds, then
+// the scalar striped path), keep the two bit-identical
+constexpr Object_Key obj_const_hash_char32(const char32_t* str, Object_Key seed = 0)
+{
+    constexpr size_t short_length = 16;
+    constexpr size_t stripe = 8;
+    size_t length = 0;
+    while (str[length]) length++;
+    // the first short_length code units, two per round
+    uint64_t h = static_cast<uint64_t>(static_cast<uintptr_t>(seed)) ^ 0x165667B19E3779F9ull;
+    size_t head = length < short_length ? length : short_length;
+    size_t i = 0;
+    for (; i + 2 <= head; i += 2) {
+        h = obj_static_key_detail::short_round(h, static_cast<uint64_t>(str[i]) | (static_cast<uint64_t>(str[i + 1]) << 32));
+    }
+    if (i < head) h = obj_static_key_detail::short_round(h, static_cast<uint64_t>(str[i]));
+    if (length <= short_length) {
+        h ^= static_cast<uint64_t>(length) * 0x9E3779B185EBCA87ull;
+        return static_cast<Object_Key>(static_cast<uintptr_t>(obj_static_key_detail::avalanche(h))) | OBJ_KEY_HASH_FLAG;
+    }
+    // the rest in stripes, seeded with h
+    const char32_t* rest = str + short_length;
+    size_t rest_length = length - short_length;
+    uint64_t acc[4] = {0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0x85EBCA77C2B2AE63ull};
+    uint64_t key[4] = {0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull};
+    for (size_t offset = 0; offset < rest_length; offset += stripe) {
+        // the last partial stripe is zero padded
+        char32_t chars[stripe] = {};
+        for (size_t j = 0; j < stripe && offset + j < rest_length; j++) chars[j] = rest[offset + j];
+        uint64_t data[4] = {};
+        for (size_t j = 0; j < 4; j++) {
+            data[j] = static_cast<uint64_t>(chars[2 * j]) | (static_cast<uint64_t>(chars[2 * j + 1]) << 32);
+        }
+        for (size_t j = 0; j < 4; j++) {
+            uint64_t mixed = data[j] ^ key[j];
+            acc[j] += (mixed & 0xFFFFFFFFull) * (mixed >> 32);
+            acc[j] += data[j ^ 1];
+            key[j] += 0x9FB21C651E98DF25ull;
+        }
+    }
+    uint64_t result = static_cast<uint64_t>(rest_length) * 0x9E3779B185EBCA87ull ^ h;
+    for (size_t j = 0; j < 4; j++) {
+        result = (result ^ obj_static_key_detail::avalanche(acc[j])) * 0x85EBCA77C2B2AE63ull;
+    }
+    return static_cast<Object_Key>(static_cast<uintptr_t>(obj_static_key_detail::avalanche(result))) | OBJ_KEY_HASH_FLAG;
+}
+
+class Static_Key_Registry {
+public:
+    struct Entry {
+        const char32_t* name;
+        Object_Key key;
+    };
+
+    static bool add(const char32_t* name, Object_Key key)
+    {
+        entries().push_back({name, key});
+        return true;
+    }
+
+    // interns and pins every registered literal, returns false if any of them collided
+    static bool verify()
+    {
+        bool ok = true;
+        for (const Entry &entry : entries()) {
+            if (obj_attr_hash_string_pinned(entry.name) != entry.key) ok = false;
+        }
+        return ok;
+    }
+
+    static const std::vector<Entry> &registered() { return entries(); }
+
+private:
+    static std::vector<Entry> &entries()
+    {
+        static std::vector<Entry> list; // constructed on first use, safe during static init
+        return list;
+    }
+};
+
+template<size_t N>
+struct Static_Key_String {
+    char32_t chars[N] = {};
+    constexpr Static_Key_String(const char32_t (&str)[N])
+    {
+        for (size_t i = 0; i < N; i++) chars[i] = str[i];
+    }
+};
+
+template<Static_Key_String Name>
+struct Static_Key {
+    static constexpr Object_Key value = obj_const_hash_char32(Name.chars);
+    static inline const bool registered = Static_Key_Registry::add(Name.chars, value);
+
+    // taking the address odr-uses registered, which instantiates the registration
+    static constexpr Object_Key get()
+    {
+        (void)&registered;
+        return value;
+    }
+};
+
+#define EDC_KEY(literal) (Static_Key<literal>::get())
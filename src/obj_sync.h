@@ -0,0 +1,227 @@
+/**
+ * @file obj_sync.h
+ * @brief Internal atomics and locking shim for the C object runtime
+ *
+ * MSVC's C mode has no usable <stdatomic.h>, so the C sources go through
+ * these helpers instead of using either toolchain's primitives directly.
+ * Not part of the public interface.
+ *
+ * obj_light_fence() and obj_heavy_fence() are an asymmetric pair for a
+ * frequent side that must order its stores before its loads and a rare side
+ * that must see them: the light fence only stops the compiler, the heavy one
+ * makes every running thread of the process execute a full barrier. They are
+ * only valid after obj_asymmetric_fence_init() returned non-zero; otherwise
+ * both sides need obj_atomic_fence().
+ */
+
+#ifndef _OBJ_SYNC_H_
+#define _OBJ_SYNC_H_
+
+#include <stdint.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+#define OBJ_THREAD_LOCAL __declspec(thread)
+#if defined(_M_X64) || defined(_M_IX86)
+#define OBJ_CPU_RELAX() _mm_pause()
+#else
+#define OBJ_CPU_RELAX() __yield()
+#endif
+
+typedef volatile long Obj_Spin_Lock;
+
+static __inline int obj_spin_try_lock(Obj_Spin_Lock* lock) {
+    return _InterlockedExchange(lock, 1) == 0;
+}
+
+static __inline void obj_spin_unlock(Obj_Spin_Lock* lock) {
+    _InterlockedExchange(lock, 0);
+}
+
+static __inline long obj_spin_is_locked(Obj_Spin_Lock* lock) {
+    return *lock;
+}
+
+// the obj_atomic_* helpers operate on plain intptr_t fields so that public
+// structs stay valid C++ when they embed one
+
+static __inline intptr_t obj_atomic_load_relaxed(const intptr_t* value) {
+    return *(const volatile intptr_t*)value;
+}
+
+static __inline intptr_t obj_atomic_load_acquire(const intptr_t* value) {
+#if defined(_M_ARM64)
+    return (intptr_t)__ldar64((unsigned __int64 volatile*)value);
+#else
+    intptr_t result = *(const volatile intptr_t*)value;
+    _ReadWriteBarrier();
+    return result;
+#endif
+}
+
+static __inline void obj_atomic_store_relaxed(intptr_t* value, intptr_t desired) {
+    *(volatile intptr_t*)value = desired;
+}
+
+static __inline void obj_atomic_store_release(intptr_t* value, intptr_t desired) {
+#if defined(_WIN64)
+    _InterlockedExchange64((volatile long long*)value, (long long)desired);
+#else
+    _InterlockedExchange((volatile long*)value, (long)desired);
+#endif
+}
+
+// returns the value observed before the exchange; it succeeded if that equals expected
+static __inline intptr_t obj_atomic_compare_exchange(intptr_t* value, intptr_t expected, intptr_t desired) {
+#if defined(_WIN64)
+    return (intptr_t)_InterlockedCompareExchange64((volatile long long*)value, (long long)desired, (long long)expected);
+#else
+    return (intptr_t)_InterlockedCompareExchange((volatile long*)value, (long)desired, (long)expected);
+#endif
+}
+
+static __inline intptr_t obj_atomic_fetch_add(intptr_t* value, intptr_t delta) {
+#if defined(_WIN64)
+    return (intptr_t)_InterlockedExchangeAdd64((volatile long long*)value, (long long)delta);
+#else
+    return (intptr_t)_InterlockedExchangeAdd((volatile long*)value, (long)delta);
+#endif
+}
+
+static __inline intptr_t obj_atomic_fetch_or(intptr_t* value, intptr_t bits) {
+#if defined(_WIN64)
+    return (intptr_t)_InterlockedOr64((volatile long long*)value, (long long)bits);
+#else
+    return (intptr_t)_InterlockedOr((volatile long*)value, (long)bits);
+#endif
+}
+
+// full barrier, also orders earlier stores before later loads
+static __inline void obj_atomic_fence() {
+#if defined(_M_ARM64)
+    __dmb(_ARM64_BARRIER_ISH);
+#elif defined(_M_X64)
+    __faststorefence();
+#else
+    _mm_mfence();
+#endif
+}
+
+// from <windows.h>, declared here so the C sources do not pull it in
+__declspec(dllimport) void __stdcall FlushProcessWriteBuffers(void);
+
+static __inline int obj_asymmetric_fence_init() {
+    return 1;
+}
+
+static __inline void obj_light_fence() {
+    _ReadWriteBarrier();
+}
+
+static __inline void obj_heavy_fence() {
+    FlushProcessWriteBuffers();
+}
+
+#else
+#include <stdatomic.h>
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+long syscall(long number, ...); // <unistd.h> hides it in strict C modes
+#endif
+
+#define OBJ_THREAD_LOCAL _Thread_local
+#if defined(__x86_64__) || defined(__i386__)
+#define OBJ_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define OBJ_CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define OBJ_CPU_RELAX() ((void)0)
+#endif
+
+typedef atomic_int Obj_Spin_Lock;
+
+static inline int obj_spin_try_lock(Obj_Spin_Lock* lock) {
+    return atomic_exchange_explicit(lock, 1, memory_order_acquire) == 0;
+}
+
+static inline void obj_spin_unlock(Obj_Spin_Lock* lock) {
+    atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+static inline int obj_spin_is_locked(Obj_Spin_Lock* lock) {
+    return atomic_load_explicit(lock, memory_order_relaxed);
+}
+
+// the obj_atomic_* helpers operate on plain intptr_t fields so that public
+// structs stay valid C++ when they embed one
+
+static inline intptr_t obj_atomic_load_relaxed(const intptr_t* value) {
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+static inline intptr_t obj_atomic_load_acquire(const intptr_t* value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static inline void obj_atomic_store_relaxed(intptr_t* value, intptr_t desired) {
+    __atomic_store_n(value, desired, __ATOMIC_RELAXED);
+}
+
+static inline void obj_atomic_store_release(intptr_t* value, intptr_t desired) {
+    __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+
+// returns the value observed before the exchange; it succeeded if that equals expected
+static inline intptr_t obj_atomic_compare_exchange(intptr_t* value, intptr_t expected, intptr_t desired) {
+    __atomic_compare_exchange_n(value, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return expected;
+}
+
+static inline intptr_t obj_atomic_fetch_add(intptr_t* value, intptr_t delta) {
+    return __atomic_fetch_add(value, delta, __ATOMIC_ACQ_REL);
+}
+
+static inline intptr_t obj_atomic_fetch_or(intptr_t* value, intptr_t bits) {
+    return __atomic_fetch_or(value, bits, __ATOMIC_ACQ_REL);
+}
+
+// full barrier, also orders earlier stores before later loads
+static inline void obj_atomic_fence() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#if defined(__linux__)
+static inline int obj_asymmetric_fence_init() {
+    return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+}
+
+static inline void obj_heavy_fence() {
+    syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+}
+#else
+static inline int obj_asymmetric_fence_init() {
+    return 0;
+}
+
+static inline void obj_heavy_fence() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif
+
+static inline void obj_light_fence() {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
+
+// test-and-test-and-set, only meant for short critical sections
+#define obj_spin_lock(lock) \
+    do { \
+        while (!obj_spin_try_lock(lock)) { \
+            while (obj_spin_is_locked(lock)) OBJ_CPU_RELAX(); \
+        } \
+    } while (0)
+
+#endif
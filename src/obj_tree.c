@@ -1,10 +1,22 @@
 #include "obj_tree.h"
+#include "obj_sync.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <uchar.h>
 
-static Object_Hash_Map obj_key_map = { 0 };
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OBJ_HASH_MAP_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define OBJ_HASH_MAP_NEON
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 char32_t const* const OBJ_TYPE = U"@object.type";
 Object_Key OBJ_TYPE_KEY = 0;
 char32_t const* const OBJ_KEY_HASH_FUNCTION = U"@object.hash_function";
@@ -15,9 +27,9 @@ char32_t const* const OBJ_DESTRUCT_FUNCTION = U"@object.destruct_function";
 Object_Key OBJ_DESTRUCT_FUNCTION_KEY = 0;
 
 static Object* obj_char32_string_type_obj = NULL;
+static Object* obj_compact_string_type_obj = NULL;
 
 static void obj_free(Object* obj);
-static void u32strcpy(char32_t* dst, const char32_t* src);
 static size_t u32strlen(const char32_t* s);
 static void* (*obj_mem_allocate)(size_t size) = malloc;
 static void (*obj_mem_deallocate)(void*) = free;
@@ -27,6 +39,10 @@ Object* obj_get_char32_string_type() {
     return obj_char32_string_type_obj;
 }
 
+Object* obj_get_compact_string_type() {
+    return obj_compact_string_type_obj;
+}
+
 Object* obj_create_char32_string(const char32_t* str)
 {
     size_t len = u32strlen(str) + 1;
@@ -36,20 +52,274 @@ Object* obj_create_char32_string(const char32_t* str)
     return obj;
 }
 
-static void init_hash_map(Object_Hash_Map* map, size_t bucket_count_log2) {
-    map->buckets = (Object_Hash_Item**)calloc((size_t)1 << bucket_count_log2, sizeof(Object_Hash_Item*));
-    if (!map->buckets) return;
-    map->bucket_count_log2 = bucket_count_log2;
-    map->obj_count = 0;
+/*
+ * String keys are hashed XXH3-style: the string is consumed in stripes of
+ * HASH_CHAR32_STRIPE code units, each 64-bit lane (two code units) is XORed
+ * with a per-lane key that advances every stripe, and the lane accumulates
+ * the product of its 32-bit halves plus its neighbour's raw data. SSE2 and
+ * NEON do two lanes per instruction, the scalar path is the reference.
+ * Keys of at most HASH_SHORT_LENGTH code units, the bulk of attribute and
+ * component names, skip the stripes and their setup: each pair of code units
+ * is one multiply-rotate round on a single accumulator. Longer keys start the
+ * same way and stripe the rest, seeded with that accumulator.
+ * obj_static_key.h mirrors this as a constexpr function, keep them bit-identical.
+ */
+#define HASH_CHAR32_STRIPE 8
+#define HASH_PRIME64_1 0x9E3779B185EBCA87ull
+#define HASH_PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define HASH_PRIME64_3 0x165667B19E3779F9ull
+#define HASH_PRIME64_4 0x85EBCA77C2B2AE63ull
+#define HASH_KEY_STEP 0x9FB21C651E98DF25ull
+#define HASH_SHORT_LENGTH 16
+
+typedef struct s_Hash_Char32_State {
+    uint64_t acc[4];
+    uint64_t key[4];
+    size_t length;
+} Hash_Char32_State;
+
+static void hash_char32_init(Hash_Char32_State* state) {
+    state->acc[0] = HASH_PRIME64_1;
+    state->acc[1] = HASH_PRIME64_2;
+    state->acc[2] = HASH_PRIME64_3;
+    state->acc[3] = HASH_PRIME64_4;
+    state->key[0] = 0xBE4BA423396CFEB8ull;
+    state->key[1] = 0x1CAD21F72C81017Cull;
+    state->key[2] = 0xDB979083E96DD4DEull;
+    state->key[3] = 0x1F67B3B7A4A44072ull;
+    state->length = 0;
+}
+
+// lane i of a stripe is chars[2i] | chars[2i + 1] << 32
+static void hash_char32_stripes(Hash_Char32_State* state, const char32_t* chars, size_t stripe_count) {
+#if defined(OBJ_HASH_MAP_SSE2)
+    __m128i acc0 = _mm_loadu_si128((const __m128i*)&state->acc[0]);
+    __m128i acc1 = _mm_loadu_si128((const __m128i*)&state->acc[2]);
+    __m128i key0 = _mm_loadu_si128((const __m128i*)&state->key[0]);
+    __m128i key1 = _mm_loadu_si128((const __m128i*)&state->key[2]);
+    const __m128i step = _mm_set1_epi64x((long long)HASH_KEY_STEP);
+    for (size_t s = 0; s < stripe_count; s++, chars += HASH_CHAR32_STRIPE) {
+        __m128i data0 = _mm_loadu_si128((const __m128i*)chars);
+        __m128i data1 = _mm_loadu_si128((const __m128i*)(chars + 4));
+        __m128i mixed0 = _mm_xor_si128(data0, key0);
+        __m128i mixed1 = _mm_xor_si128(data1, key1);
+        acc0 = _mm_add_epi64(acc0, _mm_mul_epu32(mixed0, _mm_srli_epi64(mixed0, 32)));
+        acc1 = _mm_add_epi64(acc1, _mm_mul_epu32(mixed1, _mm_srli_epi64(mixed1, 32)));
+        acc0 = _mm_add_epi64(acc0, _mm_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc1 = _mm_add_epi64(acc1, _mm_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2)));
+        key0 = _mm_add_epi64(key0, step);
+        key1 = _mm_add_epi64(key1, step);
+    }
+    _mm_storeu_si128((__m128i*)&state->acc[0], acc0);
+    _mm_storeu_si128((__m128i*)&state->acc[2], acc1);
+    _mm_storeu_si128((__m128i*)&state->key[0], key0);
+    _mm_storeu_si128((__m128i*)&state->key[2], key1);
+#elif defined(OBJ_HASH_MAP_NEON)
+    uint64x2_t acc0 = vld1q_u64(&state->acc[0]);
+    uint64x2_t acc1 = vld1q_u64(&state->acc[2]);
+    uint64x2_t key0 = vld1q_u64(&state->key[0]);
+    uint64x2_t key1 = vld1q_u64(&state->key[2]);
+    const uint64x2_t step = vdupq_n_u64(HASH_KEY_STEP);
+    for (size_t s = 0; s < stripe_count; s++, chars += HASH_CHAR32_STRIPE) {
+        uint64x2_t data0 = vreinterpretq_u64_u32(vld1q_u32((const uint32_t*)chars));
+        uint64x2_t data1 = vreinterpretq_u64_u32(vld1q_u32((const uint32_t*)(chars + 4)));
+        uint64x2_t mixed0 = veorq_u64(data0, key0);
+        uint64x2_t mixed1 = veorq_u64(data1, key1);
+        acc0 = vaddq_u64(acc0, vmull_u32(vmovn_u64(mixed0), vshrn_n_u64(mixed0, 32)));
+        acc1 = vaddq_u64(acc1, vmull_u32(vmovn_u64(mixed1), vshrn_n_u64(mixed1, 32)));
+        acc0 = vaddq_u64(acc0, vextq_u64(data0, data0, 1));
+        acc1 = vaddq_u64(acc1, vextq_u64(data1, data1, 1));
+        key0 = vaddq_u64(key0, step);
+        key1 = vaddq_u64(key1, step);
+    }
+    vst1q_u64(&state->acc[0], acc0);
+    vst1q_u64(&state->acc[2], acc1);
+    vst1q_u64(&state->key[0], key0);
+    vst1q_u64(&state->key[2], key1);
+#else
+    for (size_t s = 0; s < stripe_count; s++, chars += HASH_CHAR32_STRIPE) {
+        uint64_t data[4];
+        for (int i = 0; i < 4; i++) {
+            data[i] = (uint64_t)chars[2 * i] | ((uint64_t)chars[2 * i + 1] << 32);
+        }
+        for (int i = 0; i < 4; i++) {
+            uint64_t mixed = data[i] ^ state->key[i];
+            state->acc[i] += (mixed & 0xFFFFFFFFull) * (mixed >> 32);
+            state->acc[i] += data[i ^ 1];
+            state->key[i] += HASH_KEY_STEP;
+        }
+    }
+#endif
+    state->length += stripe_count * HASH_CHAR32_STRIPE;
+}
+
+static uint64_t hash_avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= HASH_PRIME64_2;
+    h ^= h >> 29;
+    h *= HASH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t hash_rotl(uint64_t value, int bits) {
+    return value << bits | value >> (64 - bits);
+}
+
+// the lane's multiply is off the dependency chain, which is one xor, rotate and multiply per round
+static uint64_t hash_short_round(uint64_t h, uint64_t lane) {
+    return hash_rotl(h ^ (lane * HASH_PRIME64_2), 31) * HASH_PRIME64_1;
+}
+
+static uint64_t hash_short_rounds(uint64_t h, const char32_t* chars, size_t length) {
+    size_t i = 0;
+    for (; i + 2 <= length; i += 2) {
+        h = hash_short_round(h, (uint64_t)chars[i] | ((uint64_t)chars[i + 1] << 32));
+    }
+    if (i < length) h = hash_short_round(h, (uint64_t)chars[i]);
+    return h;
 }
 
+// the length goes in last, so that a zero-terminated key can be hashed
+// while its end is still being looked for
+static Object_Key hash_short_finish(uint64_t h, size_t length) {
+    return (Object_Key)(uintptr_t)hash_avalanche(h ^ (uint64_t)length * HASH_PRIME64_1) | OBJ_KEY_HASH_FLAG;
+}
+
+// tail holds the last tail_length (< HASH_CHAR32_STRIPE) code units
+static Object_Key hash_char32_finish(Hash_Char32_State* state, const char32_t* tail, size_t tail_length, uint64_t seed) {
+    if (tail_length) {
+        char32_t last[HASH_CHAR32_STRIPE] = { 0 };
+        memcpy(last, tail, tail_length * sizeof(char32_t));
+        hash_char32_stripes(state, last, 1);
+        state->length -= HASH_CHAR32_STRIPE - tail_length;
+    }
+    uint64_t h = (uint64_t)state->length * HASH_PRIME64_1 ^ seed;
+    for (int i = 0; i < 4; i++) {
+        h = (h ^ hash_avalanche(state->acc[i])) * HASH_PRIME64_4;
+    }
+    return (Object_Key)(uintptr_t)hash_avalanche(h) | OBJ_KEY_HASH_FLAG;
+}
+
+/*
+ * A string view covers char32 strings and the 1 or 2 byte code units of
+ * compact strings alike. Narrow views are widened a block of stripes at a
+ * time, so equal text hashes the same whatever its storage width.
+ */
+#define HASH_WIDEN_STRIPES 32
+
+typedef struct s_String_View {
+    const void* chars;
+    size_t length;
+    size_t width;   // bytes per code point: 1, 2 or 4
+} String_View;
+
+static char32_t string_view_at(const String_View* view, size_t index) {
+    switch (view->width) {
+    case 1: return ((const uint8_t*)view->chars)[index];
+    case 2: return ((const uint16_t*)view->chars)[index];
+    default: return ((const char32_t*)view->chars)[index];
+    }
+}
+
+static void string_view_widen(const String_View* view, size_t start, size_t count, char32_t* out) {
+    if (view->width == 1) {
+        const uint8_t* chars = (const uint8_t*)view->chars + start;
+        for (size_t i = 0; i < count; i++) out[i] = chars[i];
+    }
+    else if (view->width == 2) {
+        const uint16_t* chars = (const uint16_t*)view->chars + start;
+        for (size_t i = 0; i < count; i++) out[i] = chars[i];
+    }
+    else {
+        memcpy(out, (const char32_t*)view->chars + start, count * sizeof(char32_t));
+    }
+}
+
+static int string_view_equal(const String_View* a, const String_View* b) {
+    if (a->length != b->length) return 0;
+    if (a->width == b->width) return memcmp(a->chars, b->chars, a->length * a->width) == 0;
+    if (a->width + b->width == 5) {
+        // char32 text against a one byte entry, what most lookups compare
+        const String_View* wide = a->width == 4 ? a : b;
+        const char32_t* chars = (const char32_t*)wide->chars;
+        const uint8_t* bytes = (const uint8_t*)(wide == a ? b : a)->chars;
+        for (size_t i = 0; i < a->length; i++) {
+            if (chars[i] != bytes[i]) return 0;
+        }
+        return 1;
+    }
+    for (size_t i = 0; i < a->length; i++) {
+        if (string_view_at(a, i) != string_view_at(b, i)) return 0;
+    }
+    return 1;
+}
+
+static size_t string_view_narrowest_width(const String_View* view) {
+    if (view->width == 1) return 1;
+    char32_t max_char = 0;
+    for (size_t i = 0; i < view->length; i++) {
+        char32_t c = string_view_at(view, i);
+        if (c > max_char) max_char = c;
+    }
+    if (max_char <= 0xFF) return 1;
+    if (max_char <= 0xFFFF) return 2;
+    return 4;
+}
+
+// the first HASH_SHORT_LENGTH code units go through the short rounds, whose
+// result seeds the stripes over the rest, so long keys do no work twice
+static Object_Key hash_string_view(const String_View* view, Object_Key seed) {
+    uint64_t h = (uint64_t)(uintptr_t)seed ^ HASH_PRIME64_3;
+    size_t head = view->length < HASH_SHORT_LENGTH ? view->length : HASH_SHORT_LENGTH;
+    if (view->width == sizeof(char32_t)) {
+        h = hash_short_rounds(h, (const char32_t*)view->chars, head);
+    }
+    else {
+        char32_t prefix[HASH_SHORT_LENGTH];
+        string_view_widen(view, 0, head, prefix);
+        h = hash_short_rounds(h, prefix, head);
+    }
+    if (view->length <= HASH_SHORT_LENGTH) return hash_short_finish(h, view->length);
+    size_t length = view->length - HASH_SHORT_LENGTH;
+    size_t stripe_count = length / HASH_CHAR32_STRIPE;
+    size_t tail_start = HASH_SHORT_LENGTH + stripe_count * HASH_CHAR32_STRIPE;
+    size_t tail_length = length % HASH_CHAR32_STRIPE;
+    Hash_Char32_State state;
+    hash_char32_init(&state);
+    if (view->width == sizeof(char32_t)) {
+        const char32_t* chars = (const char32_t*)view->chars;
+        hash_char32_stripes(&state, chars + HASH_SHORT_LENGTH, stripe_count);
+        return hash_char32_finish(&state, chars + tail_start, tail_length, h);
+    }
+    char32_t wide[HASH_WIDEN_STRIPES * HASH_CHAR32_STRIPE];
+    for (size_t done = 0; done < stripe_count;) {
+        size_t block = stripe_count - done < HASH_WIDEN_STRIPES ? stripe_count - done : HASH_WIDEN_STRIPES;
+        string_view_widen(view, HASH_SHORT_LENGTH + done * HASH_CHAR32_STRIPE, block * HASH_CHAR32_STRIPE, wide);
+        hash_char32_stripes(&state, wide, block);
+        done += block;
+    }
+    string_view_widen(view, tail_start, tail_length, wide);
+    return hash_char32_finish(&state, wide, tail_length, h);
+}
+
+// hash_string_view() on a zero-terminated string, its end looked for while
+// hashing so that short keys take a single pass
 static Object_Key hash_char32_append(Object_Key key1, const char32_t* str) {
-    intptr_t hash = key1;
-    while (*str) {
-        hash *= 31;
-        hash += *str++;
+    uint64_t h = (uint64_t)(uintptr_t)key1 ^ HASH_PRIME64_3;
+    for (size_t i = 0; i < HASH_SHORT_LENGTH; i += 2) {
+        if (!str[i]) return hash_short_finish(h, i);
+        h = hash_short_round(h, (uint64_t)str[i] | ((uint64_t)str[i + 1] << 32));
+        if (!str[i + 1]) return hash_short_finish(h, i + 1);
     }
-    return hash | OBJ_KEY_HASH_FLAG;
+    const char32_t* rest = str + HASH_SHORT_LENGTH;
+    size_t length = u32strlen(rest);
+    if (!length) return hash_short_finish(h, HASH_SHORT_LENGTH);
+    size_t stripe_count = length / HASH_CHAR32_STRIPE;
+    Hash_Char32_State state;
+    hash_char32_init(&state);
+    hash_char32_stripes(&state, rest, stripe_count);
+    return hash_char32_finish(&state, rest + stripe_count * HASH_CHAR32_STRIPE, length % HASH_CHAR32_STRIPE, h);
 }
 
 static Object_Key hash_char32_string(Closure_Data* self, const char32_t* str) {
@@ -67,66 +337,926 @@ static int compare_eq_char32_string(Closure_Data* self, void const* data1, void
 }
 
 static size_t u32strlen(const char32_t* s) {
-    int len = 0;
+    size_t len = 0;
     while (*s++) {
         len++;
     }
     return len;
 }
 
-static void u32strcpy(char32_t* dst, const char32_t* src) {
-    while (*src) {
-        *dst++ = *src++;
+static size_t compact_string_size(size_t length, size_t width) {
+    return sizeof(Obj_Compact_String) + (length + 1) * width;
+}
+
+static String_View compact_string_view(const Obj_Compact_String* str) {
+    String_View view = { str + 1, str->length, str->width };
+    return view;
+}
+
+// dst must have room for compact_string_size(src->length, width) bytes
+static void compact_string_fill(Obj_Compact_String* dst, const String_View* src, size_t width) {
+    dst->length = (uint32_t)src->length;
+    dst->width = (uint32_t)width;
+    void* chars = dst + 1;
+    if (width == src->width) {
+        memcpy(chars, src->chars, src->length * width);
+    }
+    else {
+        for (size_t i = 0; i < src->length; i++) {
+            char32_t c = string_view_at(src, i);
+            if (width == 1) ((uint8_t*)chars)[i] = (uint8_t)c;
+            else if (width == 2) ((uint16_t*)chars)[i] = (uint16_t)c;
+            else ((char32_t*)chars)[i] = c;
+        }
+    }
+    memset((char*)chars + src->length * width, 0, width);
+}
+
+static Object_Key hash_compact_string(Closure_Data* self, const Obj_Compact_String* str) {
+    String_View view = compact_string_view(str);
+    return hash_string_view(&view, 0);
+}
+
+static int compare_eq_compact_string(Closure_Data* self, void const* data1, void const* data2) {
+    String_View a = compact_string_view((const Obj_Compact_String*)data1);
+    String_View b = compact_string_view((const Obj_Compact_String*)data2);
+    return string_view_equal(&a, &b);
+}
+
+
+/*
+ * Attribute maps are flat open-addressing tables in the SwissTable style:
+ * one control byte per slot holds either EMPTY, DELETED or the low 7 bits
+ * of the slot's hash, and lookups compare a whole group of control bytes
+ * at once before touching the key array.
+ */
+#define HASH_MAP_GROUP_WIDTH 16
+#define HASH_MAP_CTRL_EMPTY ((uint8_t)0x80)
+#define HASH_MAP_CTRL_DELETED ((uint8_t)0xFE)
+
+static size_t hash_map_capacity(const Object_Hash_Map* map) {
+    return map->ctrl ? (size_t)1 << map->bucket_count_log2 : 0;
+}
+
+static size_t hash_map_growth_limit(size_t capacity) {
+    return capacity - capacity / 8; // max load factor 7/8
+}
+
+static uint64_t hash_map_mix(Object_Key key) {
+    uint64_t h = (uint64_t)(uintptr_t)key * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 32);
+}
+
+static uint32_t hash_map_ctz(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
+// bit i of the result is set when ctrl[i] == h2
+static uint32_t hash_map_group_match(const uint8_t* ctrl, uint8_t h2) {
+#if defined(OBJ_HASH_MAP_SSE2)
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#elif defined(OBJ_HASH_MAP_NEON)
+    static const uint8_t lane_bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t eq = vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(h2));
+    uint8x16_t bits = vandq_u8(eq, vld1q_u8(lane_bits));
+    return (uint32_t)vaddv_u8(vget_low_u8(bits)) | ((uint32_t)vaddv_u8(vget_high_u8(bits)) << 8);
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HASH_MAP_GROUP_WIDTH; i++) {
+        if (ctrl[i] == h2) mask |= (uint32_t)1 << i;
+    }
+    return mask;
+#endif
+}
+
+// bit i of the result is set when slot i is EMPTY or DELETED (top bit of ctrl set)
+static uint32_t hash_map_group_match_free(const uint8_t* ctrl) {
+#if defined(OBJ_HASH_MAP_SSE2)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#elif defined(OBJ_HASH_MAP_NEON)
+    static const uint8_t lane_bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t top = vtstq_u8(vld1q_u8(ctrl), vdupq_n_u8(0x80));
+    uint8x16_t bits = vandq_u8(top, vld1q_u8(lane_bits));
+    return (uint32_t)vaddv_u8(vget_low_u8(bits)) | ((uint32_t)vaddv_u8(vget_high_u8(bits)) << 8);
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HASH_MAP_GROUP_WIDTH; i++) {
+        if (ctrl[i] & 0x80) mask |= (uint32_t)1 << i;
     }
-    *dst = 0;
+    return mask;
+#endif
 }
 
+static uint32_t hash_map_group_match_empty(const uint8_t* ctrl) {
+    return hash_map_group_match(ctrl, HASH_MAP_CTRL_EMPTY);
+}
 
-static Object* obj_get_attr_internal(Object_Hash_Map* map, Object_Key key) {
-    if (!map->buckets) return NULL;
-    size_t index = key & ((1 << map->bucket_count_log2) - 1);
-    Object_Hash_Item* item = map->buckets[index];
-    while (item) {
-        if (item->key == key) {
-            return item->value;
+static void init_hash_map(Object_Hash_Map* map, size_t bucket_count_log2) {
+    if (bucket_count_log2 < OBJ_DEFAULT_BUCKET_COUNT_LOG2) bucket_count_log2 = OBJ_DEFAULT_BUCKET_COUNT_LOG2;
+    size_t capacity = (size_t)1 << bucket_count_log2;
+    // keys and values first keeps both arrays pointer aligned, control bytes trail them
+    char* block = (char*)malloc(capacity * (sizeof(Object_Key) + sizeof(Object*) + 1));
+    map->ctrl = NULL;
+    if (!block) return;
+    map->keys = (Object_Key*)block;
+    map->values = (Object**)(block + capacity * sizeof(Object_Key));
+    map->ctrl = (uint8_t*)(block + capacity * (sizeof(Object_Key) + sizeof(Object*)));
+    memset(map->ctrl, HASH_MAP_CTRL_EMPTY, capacity);
+    map->bucket_count_log2 = bucket_count_log2;
+    map->table_count = 0;
+    map->growth_left = hash_map_growth_limit(capacity);
+}
+
+static void free_hash_map(Object_Hash_Map* map) {
+    free(map->keys); // start of the single block allocated by init_hash_map
+    map->ctrl = NULL;
+    map->keys = NULL;
+    map->values = NULL;
+    map->bucket_count_log2 = 0;
+    map->table_count = 0;
+    map->growth_left = 0;
+}
+
+// returns the slot holding key, or SIZE_MAX
+static size_t hash_map_find(const Object_Hash_Map* map, Object_Key key) {
+    if (!map->ctrl) return SIZE_MAX;
+    uint64_t hash = hash_map_mix(key);
+    uint8_t h2 = (uint8_t)(hash & 0x7F);
+    size_t group_mask = (hash_map_capacity(map) / HASH_MAP_GROUP_WIDTH) - 1;
+    size_t group = (size_t)(hash >> 7) & group_mask;
+    for (size_t step = 1;; step++) {
+        const uint8_t* ctrl = map->ctrl + group * HASH_MAP_GROUP_WIDTH;
+        uint32_t match = hash_map_group_match(ctrl, h2);
+        while (match) {
+            size_t slot = group * HASH_MAP_GROUP_WIDTH + hash_map_ctz(match);
+            if (map->keys[slot] == key) return slot;
+            match &= match - 1;
         }
-        item = item->next;
+        if (hash_map_group_match_empty(ctrl)) return SIZE_MAX;
+        if (step > group_mask) return SIZE_MAX; // visited every group
+        group = (group + step) & group_mask; // triangular probing covers all groups
     }
-    return NULL;
+}
+
+// first EMPTY or DELETED slot on key's probe sequence; the table always keeps one free
+static size_t hash_map_find_free(const Object_Hash_Map* map, Object_Key key) {
+    uint64_t hash = hash_map_mix(key);
+    size_t group_mask = (hash_map_capacity(map) / HASH_MAP_GROUP_WIDTH) - 1;
+    size_t group = (size_t)(hash >> 7) & group_mask;
+    for (size_t step = 1;; step++) {
+        uint32_t match = hash_map_group_match_free(map->ctrl + group * HASH_MAP_GROUP_WIDTH);
+        if (match) return group * HASH_MAP_GROUP_WIDTH + hash_map_ctz(match);
+        group = (group + step) & group_mask;
+    }
+}
+
+static void hash_map_place(Object_Hash_Map* map, Object_Key key, Object* value) {
+    size_t slot = hash_map_find_free(map, key);
+    if (map->ctrl[slot] == HASH_MAP_CTRL_EMPTY) map->growth_left--;
+    map->ctrl[slot] = (uint8_t)(hash_map_mix(key) & 0x7F);
+    map->keys[slot] = key;
+    map->values[slot] = value;
+    map->table_count++;
+}
+
+// rebuilding also drops every DELETED marker
+static void hash_map_rehash(Object_Hash_Map* map, size_t bucket_count_log2) {
+    Object_Hash_Map old_map = *map;
+    init_hash_map(map, bucket_count_log2);
+    if (!map->ctrl) {
+        *map = old_map; // keep the old table, it is still valid
+        return;
+    }
+    size_t old_capacity = hash_map_capacity(&old_map);
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_map.ctrl[i] & 0x80) continue;
+        hash_map_place(map, old_map.keys[i], old_map.values[i]);
+    }
+    free_hash_map(&old_map);
+}
+
+// empty inline slots hold key 0 and a NULL value, so OR-ing the masked values
+// of every slot yields the match (keys are unique) without a single branch
+static Object* hash_map_inline_get(const Object_Hash_Map* map, Object_Key key) {
+    uintptr_t found = 0;
+    for (int i = 0; i < OBJ_INLINE_ATTR_COUNT; i++) {
+        uintptr_t mask = (uintptr_t)0 - (uintptr_t)(map->inline_keys[i] == key);
+        found |= mask & (uintptr_t)map->inline_values[i];
+    }
+    return (Object*)found;
+}
+
+static int hash_map_inline_find(const Object_Hash_Map* map, Object_Key key) {
+    for (int i = 0; i < OBJ_INLINE_ATTR_COUNT; i++) {
+        if (map->inline_values[i] && map->inline_keys[i] == key) return i;
+    }
+    return -1;
+}
+
+static Object* obj_get_attr_internal(Object_Hash_Map* map, Object_Key key) {
+    Object* value = hash_map_inline_get(map, key);
+    if (value || !map->ctrl) return value;
+    size_t slot = hash_map_find(map, key);
+    if (slot == SIZE_MAX) return NULL;
+    return map->values[slot];
 }
 
 static void obj_add_attr_internal(Object_Hash_Map* map, Object_Key key, Object* value) {
-    if (!map->buckets)
+    Object** value_ref = NULL;
+    int inline_index = hash_map_inline_find(map, key);
+    if (inline_index >= 0) {
+        value_ref = &map->inline_values[inline_index];
+    }
+    else if (map->ctrl) {
+        size_t slot = hash_map_find(map, key);
+        if (slot != SIZE_MAX) value_ref = &map->values[slot];
+    }
+    if (value_ref) {
+        // replace in place, the old value loses the reference held by this map
+        Object* old_value = *value_ref;
+        obj_inc_ref(value);
+        *value_ref = value;
+        obj_dec_ref(old_value);
+        return;
+    }
+    for (int i = 0; i < OBJ_INLINE_ATTR_COUNT; i++) {
+        if (map->inline_values[i]) continue;
+        map->inline_keys[i] = key;
+        map->inline_values[i] = value;
+        map->obj_count++;
+        obj_inc_ref(value);
+        return;
+    }
+    // inline slots are full, spill into the table
+    if (!map->ctrl)
     {
         init_hash_map(map, OBJ_DEFAULT_BUCKET_COUNT_LOG2);
-        assert(map->buckets);
-    }
-    size_t index = key & ((1 << map->bucket_count_log2) - 1);
-    Object_Hash_Item* item = (Object_Hash_Item*)malloc(sizeof(Object_Hash_Item));
-    if (!item) return;
-    item->key = key;
-    item->value = value;
-    item->next = map->buckets[index];
-    map->buckets[index] = item;
+        assert(map->ctrl);
+        if (!map->ctrl) return;
+    }
+    if (map->growth_left == 0) {
+        size_t capacity = hash_map_capacity(map);
+        // mostly tombstones: rebuild at the same size instead of doubling
+        size_t grow = map->table_count >= capacity / 2 ? 1 : 0;
+        hash_map_rehash(map, map->bucket_count_log2 + grow);
+        if (map->growth_left == 0) return;
+    }
+    hash_map_place(map, key, value);
     map->obj_count++;
-    value->ref_count++;
+    obj_inc_ref(value);
 }
 
-static Object_Key obj_attr_hash_internal(Closure_Data* hash_func, Closure_Data* comp_eq_func, Object* obj)
-{
-    assert(obj_key_map.buckets);
-    Object_Key key = ((Object_Key_Hash_Function)hash_func->func)(hash_func, obj->data);
-    Object* current_obj, * obj_type = obj_get_type(obj);
-    while ((current_obj = obj_get_attr_internal(&obj_key_map, key)) != NULL) {
-        if (obj_get_type(current_obj) != obj_type) continue;
-        if (current_obj == obj) return key;
-        if (comp_eq_func && ((Object_Key_Compare_Equal_Function)comp_eq_func->func)(comp_eq_func, obj->data, current_obj->data)) return key;
-        key++;
-    }
-    obj_add_attr_internal(&obj_key_map, key, obj);
+static Object* obj_remove_attr_internal(Object_Hash_Map* map, Object_Key key) {
+    int inline_index = hash_map_inline_find(map, key);
+    if (inline_index >= 0) {
+        Object* value = map->inline_values[inline_index];
+        map->inline_keys[inline_index] = 0;
+        map->inline_values[inline_index] = NULL;
+        map->obj_count--;
+        return value; // caller owns the reference the map held
+    }
+    size_t slot = hash_map_find(map, key);
+    if (slot == SIZE_MAX) return NULL;
+    Object* value = map->values[slot];
+    const uint8_t* group = map->ctrl + (slot & ~(size_t)(HASH_MAP_GROUP_WIDTH - 1));
+    // probes stop at a group that already has an EMPTY, so the slot can go back to EMPTY
+    if (hash_map_group_match_empty(group)) {
+        map->ctrl[slot] = HASH_MAP_CTRL_EMPTY;
+        map->growth_left++;
+    }
+    else {
+        map->ctrl[slot] = HASH_MAP_CTRL_DELETED;
+    }
+    map->table_count--;
+    map->obj_count--;
+    size_t capacity = hash_map_capacity(map);
+    if (map->table_count == 0) {
+        free_hash_map(map);
+    }
+    else if (map->bucket_count_log2 > OBJ_DEFAULT_BUCKET_COUNT_LOG2 &&
+        map->table_count < capacity / OBJ_HASH_MAP_MIN_LOAD_DIV) {
+        hash_map_rehash(map, map->bucket_count_log2 - 1);
+    }
+    return value; // caller owns the reference the map held
+}
+
+/*
+ * Interned keys live in a process-wide open-addressing table. Lookups of
+ * existing keys only load slots; inserts publish a new entry with a CAS on an
+ * empty slot. Growing freezes every slot of the old table with
+ * INTERN_SLOT_MOVED before publishing the new one, so an insert that races a
+ * grow fails its CAS and retries on the new table.
+ *
+ * A key is its text's hash, bumped past entries of other texts that already
+ * hold it, and attributes store only the key. A string entry is therefore
+ * just a cache from text to key and obj_sweep_interned_keys() may free it:
+ * interning the text again starts from the same hash and finds the same free
+ * key. Entries that decide a key - object keys, entries a collision was
+ * bumped past, and pinned strings - are never reclaimed. A sweep frees
+ * entries nobody looked up since the previous sweep and leaves
+ * INTERN_SLOT_VACANT behind, which probes step over; rebuilding the table
+ * drops vacant slots and sizes it to the live entries.
+ *
+ * Freed entries and replaced tables are retired, not released at once:
+ * every thread inside obj_intern() publishes the epoch it entered in, and
+ * memory retired in an epoch is released once no thread is still inside
+ * from that epoch or an earlier one. Where the platform has an asymmetric
+ * fence, publishing costs a lookup a plain store and the releasing side
+ * pays for the barrier instead.
+ *
+ * A lookup of an existing key only loads shared memory. The live, pinned
+ * and byte counts are kept per thread, like the census, and summed when
+ * they are read; only the used-slot count that decides when to grow is
+ * shared, and only inserts touch it.
+ */
+#define INTERN_INITIAL_CAPACITY_LOG2 8
+#define INTERN_SLOT_MOVED ((intptr_t)1)
+#define INTERN_SLOT_VACANT ((intptr_t)2)
+
+#define INTERN_ENTRY_PINNED 1   // never reclaimed
+#define INTERN_ENTRY_RECENT 2   // looked up since the last sweep
+#define INTERN_ENTRY_DEAD 4     // swept; only readers that loaded it before still see it
+
+typedef struct s_Intern_Entry {
+    Object_Key key;
+    Object* obj;    // NULL for strings, stored as an Obj_Compact_String right after the entry
+    intptr_t state; // INTERN_ENTRY_* flags
+} Intern_Entry;
+
+typedef struct s_Intern_Table {
+    size_t capacity_log2;
+    intptr_t slots[1];  // Intern_Entry* or INTERN_SLOT_VACANT, tagged with INTERN_SLOT_MOVED once frozen
+} Intern_Table;
+
+typedef struct s_Intern_Request {
+    int (*match)(const struct s_Intern_Request* request, const Intern_Entry* candidate);
+    Intern_Entry* (*make)(const struct s_Intern_Request* request); // key and state are filled in by obj_intern()
+    const void* data;               // the String_View or object being interned
+    Object* type;
+    Closure_Data* compare_eq;
+    int pin;
+} Intern_Request;
+
+#define INTERN_COUNT_LIVE 0
+#define INTERN_COUNT_PINNED 1
+#define INTERN_COUNT_BYTES 2
+#define INTERN_COUNTS 3
+
+typedef struct s_Intern_Reader {
+    struct s_Intern_Reader* next;
+    intptr_t epoch; // the epoch the thread entered obj_intern() in, 0 outside
+    intptr_t counts[INTERN_COUNTS]; // this thread's share of the totals, only it writes them
+    char padding[64 - (2 + INTERN_COUNTS) * sizeof(intptr_t)]; // a cache line per thread
+} Intern_Reader;
+
+typedef struct s_Intern_Retired {
+    struct s_Intern_Retired* next;
+    void* memory;
+    size_t bytes;
+    intptr_t epoch;
+} Intern_Retired;
+
+static intptr_t obj_intern_table = 0; // Intern_Table*
+static intptr_t obj_intern_count = 0; // used slots, vacant ones included
+static intptr_t obj_intern_shared_counts[INTERN_COUNTS]; // threads without a reader record
+static int obj_intern_asymmetric; // obj_asymmetric_fence_init() succeeded
+static Obj_Spin_Lock obj_intern_grow_lock;
+// the table's reference on a key object may race the owner's own refcount
+// updates, so it is taken under a lock; only inserted objects pay for it
+static Obj_Spin_Lock obj_intern_ref_lock;
+
+static intptr_t obj_intern_epoch = 1;
+static intptr_t obj_intern_readers = 0;     // Intern_Reader*, one per thread, never freed
+static intptr_t obj_intern_unregistered = 0; // readers whose record could not be allocated
+static OBJ_THREAD_LOCAL Intern_Reader* obj_intern_thread_reader;
+static OBJ_THREAD_LOCAL size_t obj_intern_depth;
+// guarded by obj_intern_grow_lock
+static Intern_Retired* obj_intern_retired;
+static size_t obj_intern_reclaimed;
+
+static void intern_count(int counter, intptr_t delta) {
+    Intern_Reader* reader = obj_intern_thread_reader;
+    if (!reader) {
+        obj_atomic_fetch_add(&obj_intern_shared_counts[counter], delta);
+        return;
+    }
+    obj_atomic_store_relaxed(&reader->counts[counter], obj_atomic_load_relaxed(&reader->counts[counter]) + delta);
+}
+
+static size_t intern_total(int counter) {
+    intptr_t total = obj_atomic_load_relaxed(&obj_intern_shared_counts[counter]);
+    for (Intern_Reader* reader = (Intern_Reader*)obj_atomic_load_acquire(&obj_intern_readers); reader; reader = reader->next) {
+        total += obj_atomic_load_relaxed(&reader->counts[counter]);
+    }
+    return total > 0 ? (size_t)total : 0; // shares read at different times
+}
+
+static size_t intern_table_bytes(size_t capacity_log2) {
+    return sizeof(Intern_Table) + (((size_t)1 << capacity_log2) - 1) * sizeof(intptr_t);
+}
+
+static Intern_Table* intern_table_create(size_t capacity_log2) {
+    Intern_Table* table = (Intern_Table*)calloc(1, intern_table_bytes(capacity_log2));
+    if (!table) return NULL;
+    table->capacity_log2 = capacity_log2;
+    intern_count(INTERN_COUNT_BYTES, (intptr_t)intern_table_bytes(capacity_log2));
+    return table;
+}
+
+static size_t intern_entry_size(const Intern_Entry* entry) {
+    if (entry->obj) return sizeof(Intern_Entry);
+    const Obj_Compact_String* str = (const Obj_Compact_String*)(entry + 1);
+    return sizeof(Intern_Entry) + compact_string_size(str->length, str->width);
+}
+
+static size_t intern_slot_index(Object_Key key, size_t mask) {
+    return (size_t)hash_map_mix(key) & mask;
+}
+
+static void intern_enter() {
+    if (obj_intern_depth++) return; // a compare_eq callback interning again
+    Intern_Reader* reader = obj_intern_thread_reader;
+    if (!reader) {
+        reader = (Intern_Reader*)calloc(1, sizeof(Intern_Reader));
+        if (!reader) {
+            obj_atomic_fetch_add(&obj_intern_unregistered, 1); // holds off every release instead
+            return;
+        }
+        intptr_t head = obj_atomic_load_acquire(&obj_intern_readers);
+        for (;;) {
+            reader->next = (Intern_Reader*)head;
+            intptr_t seen = obj_atomic_compare_exchange(&obj_intern_readers, head, (intptr_t)reader);
+            if (seen == head) break;
+            head = seen;
+        }
+        obj_intern_thread_reader = reader;
+    }
+    obj_atomic_store_relaxed(&reader->epoch, obj_atomic_load_acquire(&obj_intern_epoch));
+    // published before the first slot is loaded
+    if (obj_intern_asymmetric) obj_light_fence();
+    else obj_atomic_fence();
+}
+
+static void intern_leave() {
+    if (--obj_intern_depth) return;
+    Intern_Reader* reader = obj_intern_thread_reader;
+    if (reader) obj_atomic_store_release(&reader->epoch, 0);
+    else obj_atomic_fetch_add(&obj_intern_unregistered, -1);
+}
+
+// caller holds obj_intern_grow_lock; memory is released by intern_release_retired()
+static void intern_retire(void* memory, size_t bytes) {
+    Intern_Retired* retired = (Intern_Retired*)malloc(sizeof(Intern_Retired));
+    if (!retired) return; // leaked rather than released under a reader
+    retired->memory = memory;
+    retired->bytes = bytes;
+    retired->epoch = obj_atomic_load_relaxed(&obj_intern_epoch);
+    retired->next = obj_intern_retired;
+    obj_intern_retired = retired;
+}
+
+// caller holds obj_intern_grow_lock
+static void intern_release_retired() {
+    if (!obj_intern_retired) return;
+    // readers entering from now on can no longer reach anything retired so far
+    obj_atomic_fetch_add(&obj_intern_epoch, 1);
+    obj_atomic_fence();
+    if (obj_intern_asymmetric) obj_heavy_fence(); // readers only fenced the compiler
+    if (obj_atomic_load_acquire(&obj_intern_unregistered)) return;
+    intptr_t oldest = INTPTR_MAX;
+    for (Intern_Reader* reader = (Intern_Reader*)obj_atomic_load_acquire(&obj_intern_readers); reader; reader = reader->next) {
+        intptr_t epoch = obj_atomic_load_acquire(&reader->epoch);
+        if (epoch && epoch < oldest) oldest = epoch;
+    }
+    Intern_Retired** link = &obj_intern_retired;
+    while (*link) {
+        Intern_Retired* retired = *link;
+        if (retired->epoch >= oldest) {
+            link = &retired->next;
+            continue;
+        }
+        *link = retired->next;
+        intern_count(INTERN_COUNT_BYTES, -(intptr_t)retired->bytes);
+        free(retired->memory);
+        free(retired);
+    }
+}
+
+// returns 0 when the next table could not be allocated
+static int intern_table_grow(Intern_Table* table) {
+    obj_spin_lock(&obj_intern_grow_lock);
+    if ((Intern_Table*)obj_atomic_load_acquire(&obj_intern_table) != table) {
+        obj_spin_unlock(&obj_intern_grow_lock); // somebody else already grew it
+        return 1;
+    }
+    // vacant slots are dropped, so a table full of them is rebuilt at its size or smaller
+    size_t live = intern_total(INTERN_COUNT_LIVE);
+    size_t capacity_log2 = INTERN_INITIAL_CAPACITY_LOG2;
+    while ((((size_t)1 << capacity_log2) / 8) * 3 < live + 1) capacity_log2++;
+    Intern_Table* next = intern_table_create(capacity_log2);
+    if (!next) {
+        obj_spin_unlock(&obj_intern_grow_lock);
+        return 0;
+    }
+    size_t capacity = (size_t)1 << table->capacity_log2;
+    size_t mask = ((size_t)1 << next->capacity_log2) - 1;
+    size_t used = 0;
+    for (size_t i = 0; i < capacity; i++) {
+        intptr_t value = obj_atomic_load_acquire(&table->slots[i]);
+        for (;;) {
+            intptr_t seen = obj_atomic_compare_exchange(&table->slots[i], value, value | INTERN_SLOT_MOVED);
+            if (seen == value) break;
+            value = seen;
+        }
+        if (!value || value == INTERN_SLOT_VACANT) continue;
+        Intern_Entry* entry = (Intern_Entry*)value;
+        size_t index = intern_slot_index(entry->key, mask);
+        while (next->slots[index]) index = (index + 1) & mask;
+        next->slots[index] = value;
+        used++;
+    }
+    obj_atomic_store_relaxed(&obj_intern_count, (intptr_t)used);
+    obj_atomic_store_release(&obj_intern_table, (intptr_t)next);
+    intern_retire(table, intern_table_bytes(table->capacity_log2)); // readers may still be probing it
+    intern_release_retired();
+    obj_spin_unlock(&obj_intern_grow_lock);
+    return 1;
+}
+
+static void intern_wait_for_grow(Intern_Table* table) {
+    while ((Intern_Table*)obj_atomic_load_acquire(&obj_intern_table) == table) OBJ_CPU_RELAX();
+}
+
+#define INTERN_VISIT_FOUND 0
+#define INTERN_VISIT_BUMP 1 // the entry holds the key for another value
+#define INTERN_VISIT_SKIP 2 // the entry is being swept, probe on as if it were vacant
+
+static int intern_visit(const Intern_Request* request, Intern_Entry* entry) {
+    intptr_t state = obj_atomic_load_relaxed(&entry->state);
+    if (state & INTERN_ENTRY_DEAD) return INTERN_VISIT_SKIP;
+    int matched = request->match(request, entry);
+    // an entry bumped past is pinned, keys after it depend on it now
+    intptr_t flag = matched && !request->pin ? INTERN_ENTRY_RECENT : INTERN_ENTRY_PINNED;
+    int visit = matched ? INTERN_VISIT_FOUND : INTERN_VISIT_BUMP;
+    if (state & (flag | INTERN_ENTRY_PINNED)) return visit;
+    intptr_t old = obj_atomic_fetch_or(&entry->state, flag);
+    if (old & INTERN_ENTRY_DEAD) return INTERN_VISIT_SKIP;
+    if (flag == INTERN_ENTRY_PINNED && !(old & INTERN_ENTRY_PINNED)) intern_count(INTERN_COUNT_PINNED, 1);
+    return visit;
+}
+
+static Object_Key intern_probe(const Intern_Request* request, Object_Key key) {
+    Intern_Entry* entry = NULL;
+    for (;;) {
+        Intern_Table* table = (Intern_Table*)obj_atomic_load_acquire(&obj_intern_table);
+        assert(table);
+        size_t mask = ((size_t)1 << table->capacity_log2) - 1;
+        size_t index = intern_slot_index(key, mask);
+        size_t probes = 0;
+        for (;;) {
+            intptr_t value = obj_atomic_load_acquire(&table->slots[index]);
+            if (value == 0) {
+                // keep the load factor under 3/4 so probe runs stay short
+                size_t count = (size_t)obj_atomic_load_relaxed(&obj_intern_count);
+                if (probes > mask || count + 1 > mask - mask / 4) {
+                    if (intern_table_grow(table)) break;
+                    free(entry); // out of memory, like a failed make below
+                    return 0;
+                }
+                if (!entry) {
+                    entry = request->make(request);
+                    if (!entry) return 0;
+                    entry->state = request->pin ? INTERN_ENTRY_PINNED : INTERN_ENTRY_RECENT;
+                }
+                entry->key = key;
+                value = obj_atomic_compare_exchange(&table->slots[index], 0, (intptr_t)entry);
+                if (value == 0) {
+                    if (entry->obj) {
+                        obj_spin_lock(&obj_intern_ref_lock);
+                        obj_inc_ref(entry->obj); // held by the table for the process lifetime
+                        obj_spin_unlock(&obj_intern_ref_lock);
+                    }
+                    obj_atomic_fetch_add(&obj_intern_count, 1);
+                    intern_count(INTERN_COUNT_LIVE, 1);
+                    intern_count(INTERN_COUNT_BYTES, (intptr_t)intern_entry_size(entry));
+                    if (request->pin) intern_count(INTERN_COUNT_PINNED, 1);
+                    return key;
+                }
+            }
+            if (value & INTERN_SLOT_MOVED) {
+                intern_wait_for_grow(table);
+                break;
+            }
+            Intern_Entry* current = (Intern_Entry*)value;
+            if (value != INTERN_SLOT_VACANT && current->key == key) {
+                int visit = intern_visit(request, current);
+                if (visit == INTERN_VISIT_FOUND) {
+                    free(entry); // lost the race to an equal entry, if one was made
+                    return key;
+                }
+                if (visit == INTERN_VISIT_BUMP) {
+                    key++;
+                    index = intern_slot_index(key, mask);
+                    probes = 0;
+                    continue;
+                }
+            }
+            index = (index + 1) & mask;
+            probes++;
+        }
+        // the table changed, keys below the current one are known not to match
+    }
+}
+
+// returns the key of the entry matching request, starting at key and bumping it past collisions
+static Object_Key obj_intern(const Intern_Request* request, Object_Key key) {
+    intern_enter();
+    key = intern_probe(request, key);
+    intern_leave();
     return key;
 }
 
+static int intern_match_object(const Intern_Request* request, const Intern_Entry* entry) {
+    Object* obj = (Object*)request->data;
+    Object* candidate = entry->obj;
+    if (!candidate) return 0; // strings never reach this path, see obj_attr_key_hash()
+    if (candidate == obj) return 1;
+    if (obj_get_type(candidate) != request->type) return 0;
+    if (!request->compare_eq) return 0;
+    return ((Object_Key_Compare_Equal_Function)request->compare_eq->func)(request->compare_eq, obj->data, candidate->data);
+}
+
+static Intern_Entry* intern_make_object(const Intern_Request* request) {
+    Intern_Entry* entry = (Intern_Entry*)malloc(sizeof(Intern_Entry));
+    if (!entry) return NULL;
+    entry->obj = (Object*)request->data;
+    return entry;
+}
+
+static int intern_match_string(const Intern_Request* request, const Intern_Entry* entry) {
+    if (entry->obj) return 0;
+    String_View candidate = compact_string_view((const Obj_Compact_String*)(entry + 1));
+    return string_view_equal((const String_View*)request->data, &candidate);
+}
+
+// string keys keep a compact copy inside the entry instead of a whole object
+static Intern_Entry* intern_make_string(const Intern_Request* request) {
+    const String_View* view = (const String_View*)request->data;
+    size_t width = string_view_narrowest_width(view);
+    Intern_Entry* entry = (Intern_Entry*)malloc(sizeof(Intern_Entry) + compact_string_size(view->length, width));
+    if (!entry) return NULL;
+    entry->obj = NULL;
+    compact_string_fill((Obj_Compact_String*)(entry + 1), view, width);
+    return entry;
+}
+
+static Object_Key obj_intern_string(const String_View* view, int pin) {
+    Intern_Request request;
+    request.match = intern_match_string;
+    request.make = intern_make_string;
+    request.data = view;
+    request.type = NULL;
+    request.compare_eq = NULL;
+    request.pin = pin;
+    return obj_intern(&request, hash_string_view(view, 0));
+}
+
+size_t obj_sweep_interned_keys() {
+    if (!obj_atomic_load_acquire(&obj_intern_table)) return 0;
+    size_t reclaimed = 0;
+    obj_spin_lock(&obj_intern_grow_lock); // slots are neither frozen nor moved meanwhile
+    Intern_Table* table = (Intern_Table*)obj_atomic_load_acquire(&obj_intern_table);
+    size_t capacity = (size_t)1 << table->capacity_log2;
+    for (size_t i = 0; i < capacity; i++) {
+        intptr_t value = obj_atomic_load_acquire(&table->slots[i]);
+        if (!value || value == INTERN_SLOT_VACANT) continue;
+        Intern_Entry* entry = (Intern_Entry*)value;
+        intptr_t state = obj_atomic_load_relaxed(&entry->state);
+        if (state & INTERN_ENTRY_PINNED) continue;
+        if (state & INTERN_ENTRY_RECENT) {
+            // a lost exchange only keeps the entry for another round
+            obj_atomic_compare_exchange(&entry->state, state, state & ~(intptr_t)INTERN_ENTRY_RECENT);
+            continue;
+        }
+        if (obj_atomic_compare_exchange(&entry->state, 0, INTERN_ENTRY_DEAD) != 0) continue;
+        obj_atomic_store_release(&table->slots[i], INTERN_SLOT_VACANT);
+        intern_retire(entry, intern_entry_size(entry));
+        intern_count(INTERN_COUNT_LIVE, -1);
+        reclaimed++;
+    }
+    obj_intern_reclaimed += reclaimed;
+    intern_release_retired();
+    obj_spin_unlock(&obj_intern_grow_lock);
+    return reclaimed;
+}
+
+Obj_Intern_Stats obj_get_intern_stats() {
+    Obj_Intern_Stats stats;
+    memset(&stats, 0, sizeof(stats));
+    obj_spin_lock(&obj_intern_grow_lock);
+    Intern_Table* table = (Intern_Table*)obj_atomic_load_acquire(&obj_intern_table);
+    if (table) stats.capacity = (size_t)1 << table->capacity_log2;
+    stats.reclaimed_keys = obj_intern_reclaimed;
+    obj_spin_unlock(&obj_intern_grow_lock);
+    stats.live_keys = intern_total(INTERN_COUNT_LIVE);
+    stats.pinned_keys = intern_total(INTERN_COUNT_PINNED);
+    size_t used = (size_t)obj_atomic_load_relaxed(&obj_intern_count);
+    stats.vacant_slots = used > stats.live_keys ? used - stats.live_keys : 0;
+    stats.bytes = intern_total(INTERN_COUNT_BYTES);
+    return stats;
+}
+
+#ifdef OBJ_BIASED_REFCOUNT
+/*
+ * Biased reference counting: the thread that created an object counts its
+ * references in the plain ref_count field, every other thread goes through
+ * the atomic shared_ref_count, stored as (count * OBJ_SHARED_REF_ONE) | flags.
+ * The shared count may go negative while the owner still holds biased
+ * references. When the biased count drops to zero the owner sets MERGED,
+ * after which the shared count alone decides when the object dies and the
+ * owner uses the atomic path too.
+ *
+ * A reference handed to another thread without obj_share() is released
+ * there, driving the shared count below zero while the owner's biased count
+ * still includes it; the owner may never touch the object again. The thread
+ * whose release goes below zero sets QUEUED and queues the object on its
+ * owner, which folds its biased count into the shared one the next time it
+ * creates an object or calls obj_merge_shared_refs(). A queued object is
+ * only freed by that merge.
+ */
+#define OBJ_SHARED_REF_MERGED 1
+#define OBJ_SHARED_REF_QUEUED 2
+#define OBJ_SHARED_REF_FLAGS 3
+#define OBJ_SHARED_REF_ONE 4
+
+typedef struct s_Obj_Merge_Node {
+    Object* obj;
+    struct s_Obj_Merge_Node* next;
+} Obj_Merge_Node;
+
+// one per thread that created an object, never freed, so late releases on
+// objects of a thread that has exited still have a queue to go to
+typedef struct s_Obj_Ref_Owner {
+    intptr_t merge_queue; // Obj_Merge_Node*, pushed by other threads
+} Obj_Ref_Owner;
+
+static OBJ_THREAD_LOCAL Obj_Ref_Owner* obj_thread_owner;
+
+// NULL if the record could not be allocated; such a thread's objects are
+// created merged and never biased
+static Obj_Ref_Owner* obj_create_thread_owner() {
+    Obj_Ref_Owner* owner = obj_thread_owner;
+    if (!owner) {
+        owner = (Obj_Ref_Owner*)calloc(1, sizeof(Obj_Ref_Owner));
+        obj_thread_owner = owner;
+    }
+    return owner;
+}
+
+static const void* obj_current_thread() {
+    return obj_thread_owner;
+}
+
+static intptr_t obj_shared_ref_count(intptr_t shared) {
+    return (shared - (shared & OBJ_SHARED_REF_FLAGS)) / OBJ_SHARED_REF_ONE;
+}
+
+// only the owner ever sets MERGED, so the owner's own relaxed read is exact
+static int obj_is_biased_to_current_thread(Object* obj) {
+    return obj->owner_thread == obj_current_thread() &&
+        !(obj_atomic_load_relaxed(&obj->shared_ref_count) & OBJ_SHARED_REF_MERGED);
+}
+
+static void obj_queue_merge(Object* obj) {
+    Obj_Ref_Owner* owner = (Obj_Ref_Owner*)obj->owner_thread;
+    Obj_Merge_Node* node = (Obj_Merge_Node*)malloc(sizeof(Obj_Merge_Node));
+    if (!node) return; // leaked, as it would be without the queue
+    node->obj = obj;
+    intptr_t head = obj_atomic_load_relaxed(&owner->merge_queue);
+    for (;;) {
+        node->next = (Obj_Merge_Node*)head;
+        intptr_t seen = obj_atomic_compare_exchange(&owner->merge_queue, head, (intptr_t)node);
+        if (seen == head) break;
+        head = seen;
+    }
+}
+
+// the last biased reference is gone; a queued object is left to the merge
+static void obj_release_biased(Object* obj) {
+    intptr_t old = obj_atomic_fetch_or(&obj->shared_ref_count, OBJ_SHARED_REF_MERGED);
+    if (obj_shared_ref_count(old) == 0 && !(old & OBJ_SHARED_REF_QUEUED)) obj_free(obj);
+}
+
+static void obj_release_shared(Object* obj, size_t n) {
+    intptr_t delta = (intptr_t)n * OBJ_SHARED_REF_ONE;
+    intptr_t old = obj_atomic_load_relaxed(&obj->shared_ref_count);
+    if (old & OBJ_SHARED_REF_MERGED) {
+        // MERGED is never cleared, so no CAS is needed from here on
+        old = obj_atomic_fetch_add(&obj->shared_ref_count, -delta);
+        if (!(old & OBJ_SHARED_REF_QUEUED) && obj_shared_ref_count(old) == (intptr_t)n) obj_free(obj);
+        return;
+    }
+    // deciding to queue in the same update keeps the owner from freeing the
+    // object before it is on the queue
+    intptr_t next;
+    for (;;) {
+        next = old - delta;
+        if (!(old & OBJ_SHARED_REF_FLAGS) && obj_shared_ref_count(next) < 0) next |= OBJ_SHARED_REF_QUEUED;
+        intptr_t seen = obj_atomic_compare_exchange(&obj->shared_ref_count, old, next);
+        if (seen == old) break;
+        old = seen;
+    }
+    if ((next ^ old) & OBJ_SHARED_REF_QUEUED) obj_queue_merge(obj);
+    else if ((old & OBJ_SHARED_REF_FLAGS) == OBJ_SHARED_REF_MERGED && obj_shared_ref_count(old) == (intptr_t)n) obj_free(obj);
+}
+
+void obj_inc_ref(Object* obj) {
+    if (!obj) return;
+    if (obj_is_biased_to_current_thread(obj)) {
+        obj->ref_count++;
+        return;
+    }
+    obj_atomic_fetch_add(&obj->shared_ref_count, OBJ_SHARED_REF_ONE);
+}
+
+void obj_dec_ref(Object* obj) {
+    if (!obj) return;
+    if (obj_is_biased_to_current_thread(obj)) {
+        obj->ref_count--;
+        if (obj->ref_count > 0) return;
+        obj_release_biased(obj);
+        return;
+    }
+    obj_release_shared(obj, 1);
+}
+
+// the batch forms look up the current thread once for all their objects
+static const void* obj_ref_thread(void) {
+    return obj_current_thread();
+}
+
+static void obj_add_refs(Object* obj, size_t n, const void* thread) {
+    if (obj->owner_thread == thread && !(obj_atomic_load_relaxed(&obj->shared_ref_count) & OBJ_SHARED_REF_MERGED)) {
+        obj->ref_count += n;
+        return;
+    }
+    obj_atomic_fetch_add(&obj->shared_ref_count, (intptr_t)n * OBJ_SHARED_REF_ONE);
+}
+
+static void obj_drop_refs(Object* obj, size_t n, const void* thread) {
+    if (obj->owner_thread == thread && !(obj_atomic_load_relaxed(&obj->shared_ref_count) & OBJ_SHARED_REF_MERGED)) {
+        obj->ref_count -= n;
+        if (obj->ref_count > 0) return;
+        obj_release_biased(obj);
+        return;
+    }
+    obj_release_shared(obj, n);
+}
+
+void obj_share(Object* obj) {
+    if (!obj) return;
+    if (!obj_is_biased_to_current_thread(obj)) return;
+    intptr_t biased = (intptr_t)obj->ref_count;
+    if (biased == 0) return; // the caller must hold a reference
+    obj->ref_count = 0;
+    obj_atomic_fetch_add(&obj->shared_ref_count, biased * OBJ_SHARED_REF_ONE + OBJ_SHARED_REF_MERGED);
+}
+
+size_t obj_merge_shared_refs() {
+    Obj_Ref_Owner* owner = obj_thread_owner;
+    if (!owner) return 0;
+    intptr_t head = obj_atomic_load_acquire(&owner->merge_queue);
+    while (head) {
+        intptr_t seen = obj_atomic_compare_exchange(&owner->merge_queue, head, 0);
+        if (seen == head) break;
+        head = seen;
+    }
+    size_t merged = 0;
+    Obj_Merge_Node* node = (Obj_Merge_Node*)head;
+    while (node) {
+        Obj_Merge_Node* next = node->next;
+        Object* obj = node->obj;
+        free(node);
+        // the biased count joins the shared one and QUEUED goes, after which
+        // other threads free the object as usual
+        intptr_t delta = (intptr_t)obj->ref_count * OBJ_SHARED_REF_ONE - OBJ_SHARED_REF_QUEUED;
+        obj->ref_count = 0;
+        if (!(obj_atomic_load_relaxed(&obj->shared_ref_count) & OBJ_SHARED_REF_MERGED)) delta += OBJ_SHARED_REF_MERGED;
+        intptr_t old = obj_atomic_fetch_add(&obj->shared_ref_count, delta);
+        if (obj_shared_ref_count(old + delta) == 0) obj_free(obj);
+        merged++;
+        node = next;
+    }
+    return merged;
+}
+#else
 void obj_inc_ref(Object *obj) {
     if (!obj) return;
     obj->ref_count++;
@@ -139,6 +1269,60 @@ void obj_dec_ref(Object* obj) {
     obj_free(obj);
 }
 
+static const void* obj_ref_thread(void) {
+    return NULL;
+}
+
+static void obj_add_refs(Object* obj, size_t n, const void* thread) {
+    (void)thread;
+    obj->ref_count += n;
+}
+
+static void obj_drop_refs(Object* obj, size_t n, const void* thread) {
+    (void)thread;
+    obj->ref_count -= n;
+    if (obj->ref_count > 0) return;
+    obj_free(obj);
+}
+
+void obj_share(Object* obj) {
+    (void)obj; // plain counts, nothing to hand over
+}
+
+size_t obj_merge_shared_refs() {
+    return 0;
+}
+#endif
+
+// a run of the same object is one count update, an atomic one at most
+void obj_inc_refs(Object* const* objs, size_t count) {
+    const void* thread = obj_ref_thread();
+    for (size_t i = 0; i < count; i++) {
+        Object* obj = objs[i];
+        if (!obj) continue;
+        size_t n = 1;
+        while (i + 1 < count && objs[i + 1] == obj) {
+            n++;
+            i++;
+        }
+        obj_add_refs(obj, n, thread);
+    }
+}
+
+void obj_dec_refs(Object* const* objs, size_t count) {
+    const void* thread = obj_ref_thread();
+    for (size_t i = 0; i < count; i++) {
+        Object* obj = objs[i];
+        if (!obj) continue;
+        size_t n = 1;
+        while (i + 1 < count && objs[i + 1] == obj) {
+            n++;
+            i++;
+        }
+        obj_drop_refs(obj, n, thread);
+    }
+}
+
 Closure_Data* obj_query_method(Object* obj, Object_Key key) {
     Object* method_obj = obj_get_attr_internal(&obj->attrs_and_children, key);
     if (method_obj) return method_obj->data;
@@ -152,66 +1336,597 @@ Closure_Data* obj_query_method(Object* obj, Object_Key key) {
 }
 
 Object_Key obj_attr_key_hash(Object* obj) {
+    Object* type = obj_get_type(obj);
+    // strings intern by content whatever their width, without keeping the object
+    if (type == obj_char32_string_type_obj) return obj_attr_hash_string(obj->data);
+    if (type && type == obj_compact_string_type_obj) {
+        String_View view = compact_string_view(obj->data);
+        return obj_intern_string(&view, 0);
+    }
     Closure_Data* hash_func = obj_query_method(obj, OBJ_KEY_HASH_FUNCTION_KEY);
     if (!hash_func) return 0;
-    Closure_Data* comp_eq_func = obj_query_method(obj, OBJ_KEY_COMPARE_EQ_FUNCTION_KEY);
-    return OBJ_KEY_HASH_FLAG | obj_attr_hash_internal(hash_func, comp_eq_func, obj);
+    Intern_Request request;
+    request.match = intern_match_object;
+    request.make = intern_make_object;
+    request.data = obj;
+    request.type = type;
+    request.compare_eq = obj_query_method(obj, OBJ_KEY_COMPARE_EQ_FUNCTION_KEY);
+    request.pin = 1; // the entry holds a reference on obj
+    Object_Key key = ((Object_Key_Hash_Function)hash_func->func)(hash_func, obj->data);
+    return obj_intern(&request, key | OBJ_KEY_HASH_FLAG);
 }
 
 Object_Key obj_attr_hash_string(const char32_t* str) {
-    assert(obj_key_map.buckets);
-    Object_Key key = hash_char32_string(NULL, str) | OBJ_KEY_HASH_FLAG;
-    Object* current_obj;
-    while ((current_obj = obj_get_attr_internal(&obj_key_map, key)) != NULL) {
-        if (obj_get_type(current_obj) != obj_char32_string_type_obj) continue;
-        if (compare_eq_char32_string(NULL, str, current_obj->data)) return key;
-        key++;
-    }
-    Object* obj = obj_create(sizeof(char32_t) * (u32strlen(str) + 1), _Alignof(char32_t));
-    if (!obj) return 0;
-    u32strcpy(obj->data, str);
-    obj_debug_add_tag(obj, obj->data);
-    obj_set_type(obj, obj_char32_string_type_obj);
-    obj_add_attr_internal(&obj_key_map, key, obj);
-    return key;
+    String_View view = { str, u32strlen(str), sizeof(char32_t) };
+    return obj_intern_string(&view, 0);
+}
+
+Object_Key obj_attr_hash_string_pinned(const char32_t* str) {
+    String_View view = { str, u32strlen(str), sizeof(char32_t) };
+    return obj_intern_string(&view, 1);
 }
 
 void obj_init_key_map() {
+    if (obj_atomic_load_acquire(&obj_intern_table)) return;
+    obj_intern_asymmetric = obj_asymmetric_fence_init();
+    obj_atomic_store_release(&obj_intern_table, (intptr_t)intern_table_create(INTERN_INITIAL_CAPACITY_LOG2));
 
-    // start bootstrap
-    init_hash_map(&obj_key_map, OBJ_DEFAULT_BUCKET_COUNT_LOG2);
+    // start bootstrap: these keys are needed before a string can be interned
+    OBJ_TYPE_KEY = hash_char32_string(NULL, OBJ_TYPE);
     OBJ_KEY_HASH_FUNCTION_KEY = hash_char32_string(NULL, OBJ_KEY_HASH_FUNCTION);
-    Object* hash_char32_string_obj = obj_create(0, 0);
-    hash_char32_string_obj->data = (void*)OBJ_KEY_HASH_FUNCTION_KEY;
+    OBJ_KEY_COMPARE_EQ_FUNCTION_KEY = hash_char32_string(NULL, OBJ_KEY_COMPARE_EQ_FUNCTION);
+
     Object* hash_char32_func_obj = obj_create(sizeof(Closure_Data), _Alignof(Closure_Data));
-    obj_debug_add_tag(hash_char32_string_obj, OBJ_KEY_HASH_FUNCTION);
     obj_debug_add_tag(hash_char32_func_obj, OBJ_KEY_HASH_FUNCTION);
     ((Closure_Data*)hash_char32_func_obj->data)->func = (void*)hash_char32_string;
 
-    OBJ_KEY_COMPARE_EQ_FUNCTION_KEY = hash_char32_string(NULL, OBJ_KEY_COMPARE_EQ_FUNCTION);
-    Object* compare_eq_char32_string_obj = obj_create(0, 0);
-    compare_eq_char32_string_obj->data = (void*)OBJ_KEY_COMPARE_EQ_FUNCTION_KEY;
     Object* compare_eq_char32_func_obj = obj_create(sizeof(Closure_Data), _Alignof(Closure_Data));
-    obj_debug_add_tag(compare_eq_char32_string_obj, OBJ_KEY_COMPARE_EQ_FUNCTION);
     obj_debug_add_tag(compare_eq_char32_func_obj, OBJ_KEY_COMPARE_EQ_FUNCTION);
     ((Closure_Data*)compare_eq_char32_func_obj->data)->func = (void*)compare_eq_char32_string;
 
-    OBJ_TYPE_KEY = hash_char32_string(NULL, OBJ_TYPE);
-    Object* obj_type_obj = obj_create(0, 0);
-    obj_debug_add_tag(obj_type_obj, OBJ_TYPE);
-    obj_type_obj->data = (void*)OBJ_TYPE_KEY;
-    obj_add_attr_internal(&obj_key_map, OBJ_TYPE_KEY, obj_type_obj);
-
     obj_char32_string_type_obj = obj_create(0, 0);
+    obj_inc_ref(obj_char32_string_type_obj); // owned by the runtime
     obj_debug_add_tag(obj_char32_string_type_obj, U"@object.char32_string_type_obj");
-    obj_set_type(hash_char32_string_obj, obj_char32_string_type_obj);
-    obj_set_type(compare_eq_char32_string_obj, obj_char32_string_type_obj);
     obj_add_attr_internal(&obj_char32_string_type_obj->attrs_and_children, OBJ_KEY_HASH_FUNCTION_KEY, hash_char32_func_obj);
     obj_add_attr_internal(&obj_char32_string_type_obj->attrs_and_children, OBJ_KEY_COMPARE_EQ_FUNCTION_KEY, compare_eq_char32_func_obj);
     // end bootstrap
 
-    OBJ_DESTRUCT_FUNCTION_KEY = obj_attr_hash_string(OBJ_DESTRUCT_FUNCTION);
+    // the table is empty, so the bootstrap strings intern to their plain hashes
+    Object_Key key = obj_attr_hash_string_pinned(OBJ_TYPE);
+    assert(key == OBJ_TYPE_KEY);
+    key = obj_attr_hash_string_pinned(OBJ_KEY_HASH_FUNCTION);
+    assert(key == OBJ_KEY_HASH_FUNCTION_KEY);
+    key = obj_attr_hash_string_pinned(OBJ_KEY_COMPARE_EQ_FUNCTION);
+    assert(key == OBJ_KEY_COMPARE_EQ_FUNCTION_KEY);
+    (void)key;
+
+    OBJ_DESTRUCT_FUNCTION_KEY = obj_attr_hash_string_pinned(OBJ_DESTRUCT_FUNCTION);
+
+    Object* hash_compact_func_obj = obj_create(sizeof(Closure_Data), _Alignof(Closure_Data));
+    ((Closure_Data*)hash_compact_func_obj->data)->func = (void*)hash_compact_string;
+    Object* compare_eq_compact_func_obj = obj_create(sizeof(Closure_Data), _Alignof(Closure_Data));
+    ((Closure_Data*)compare_eq_compact_func_obj->data)->func = (void*)compare_eq_compact_string;
+    obj_compact_string_type_obj = obj_create(0, 0);
+    obj_inc_ref(obj_compact_string_type_obj); // owned by the runtime
+    obj_debug_add_tag(obj_compact_string_type_obj, U"@object.compact_string_type_obj");
+    obj_add_attr(obj_compact_string_type_obj, OBJ_KEY_HASH_FUNCTION_KEY, hash_compact_func_obj);
+    obj_add_attr(obj_compact_string_type_obj, OBJ_KEY_COMPARE_EQ_FUNCTION_KEY, compare_eq_compact_func_obj);
+}
+
+static uint64_t obj_now_ns() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Per-object data that few objects have, such as change trackers, lives in
+ * a side table keyed by the object, so the others do not carry a pointer
+ * for it; a bit in the object says whether it has an entry, objects without
+ * one never look. The table is split into OBJ_SIDE_SHARDS linear-probing
+ * tables, each under its own lock, so threads working on their own objects
+ * rarely meet. Removal shifts the entries behind the hole back, there are
+ * no tombstones. A shard keeps its slots once allocated, so churn does not
+ * allocate them again.
+ */
+#define OBJ_SIDE_SHARDS 64
+#define OBJ_SIDE_INITIAL_CAPACITY 16
+#define OBJ_SIDE_TRACKER 0
+#define OBJ_SIDE_FIELDS 1
+
+typedef struct s_Obj_Side_Entry {
+    const Object* obj;  // NULL for a free slot, whose fields are NULL too
+    void* fields[OBJ_SIDE_FIELDS];
+} Obj_Side_Entry;
+
+typedef struct s_Obj_Side_Shard {
+    Obj_Spin_Lock lock;
+    Obj_Side_Entry* entries;
+    size_t capacity;    // a power of two, 0 until the first insert
+    size_t count;       // at most half the capacity
+} Obj_Side_Shard;
+
+static Obj_Side_Shard obj_side_shards[OBJ_SIDE_SHARDS];
+
+// the top bits pick the shard, the rest the slot
+static uint64_t side_hash(const Object* obj) {
+    return (uint64_t)(uintptr_t)obj * HASH_PRIME64_1;
+}
+
+static Obj_Side_Shard* side_shard(uint64_t hash) {
+    return &obj_side_shards[hash >> 58];
+}
+
+static size_t side_home(const Obj_Side_Shard* shard, uint64_t hash) {
+    return (size_t)(hash ^ (hash >> 29)) & (shard->capacity - 1);
+}
+
+// caller holds the shard's lock; NULL if obj has no entry
+static Obj_Side_Entry* side_find(Obj_Side_Shard* shard, const Object* obj, uint64_t hash) {
+    if (!shard->capacity) return NULL;
+    size_t mask = shard->capacity - 1;
+    for (size_t i = side_home(shard, hash);; i = (i + 1) & mask) {
+        Obj_Side_Entry* entry = &shard->entries[i];
+        if (entry->obj == obj) return entry;
+        if (!entry->obj) return NULL;
+    }
+}
+
+// caller holds the shard's lock and knows obj has no entry; NULL when out of memory
+static Obj_Side_Entry* side_insert(Obj_Side_Shard* shard, const Object* obj, uint64_t hash) {
+    if ((shard->count + 1) * 2 > shard->capacity) {
+        size_t capacity = shard->capacity ? shard->capacity * 2 : OBJ_SIDE_INITIAL_CAPACITY;
+        Obj_Side_Entry* entries = (Obj_Side_Entry*)calloc(capacity, sizeof(Obj_Side_Entry));
+        if (!entries) return NULL;
+        Obj_Side_Entry* old_entries = shard->entries;
+        size_t old_capacity = shard->capacity;
+        shard->entries = entries;
+        shard->capacity = capacity;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (!old_entries[i].obj) continue;
+            size_t slot = side_home(shard, side_hash(old_entries[i].obj));
+            while (entries[slot].obj) slot = (slot + 1) & (capacity - 1);
+            entries[slot] = old_entries[i];
+        }
+        free(old_entries);
+    }
+    size_t slot = side_home(shard, hash);
+    while (shard->entries[slot].obj) slot = (slot + 1) & (shard->capacity - 1);
+    shard->entries[slot].obj = obj;
+    shard->count++;
+    return &shard->entries[slot];
+}
+
+// caller holds the shard's lock
+static void side_remove(Obj_Side_Shard* shard, Obj_Side_Entry* entry) {
+    size_t mask = shard->capacity - 1;
+    size_t hole = (size_t)(entry - shard->entries);
+    for (size_t i = (hole + 1) & mask; shard->entries[i].obj; i = (i + 1) & mask) {
+        // an entry may fill the hole unless its home lies between the hole and itself
+        size_t home = side_home(shard, side_hash(shard->entries[i].obj));
+        if (((i - home) & mask) < ((i - hole) & mask)) continue;
+        shard->entries[hole] = shard->entries[i];
+        hole = i;
+    }
+    memset(&shard->entries[hole], 0, sizeof(Obj_Side_Entry));
+    shard->count--;
+}
+
+// NULL if obj has no entry or the field is unset
+static void* obj_side_get(const Object* obj, int field) {
+    uint64_t hash = side_hash(obj);
+    Obj_Side_Shard* shard = side_shard(hash);
+    obj_spin_lock(&shard->lock);
+    Obj_Side_Entry* entry = side_find(shard, obj, hash);
+    void* value = entry ? entry->fields[field] : NULL;
+    obj_spin_unlock(&shard->lock);
+    return value;
+}
+
+// an entry is removed with its last field; returns 0 when out of memory
+static int obj_side_set(const Object* obj, int field, void* value) {
+    uint64_t hash = side_hash(obj);
+    Obj_Side_Shard* shard = side_shard(hash);
+    obj_spin_lock(&shard->lock);
+    Obj_Side_Entry* entry = side_find(shard, obj, hash);
+    if (!entry && value) entry = side_insert(shard, obj, hash);
+    if (entry) {
+        entry->fields[field] = value;
+        int used = 0;
+        for (int i = 0; i < OBJ_SIDE_FIELDS; i++) used |= entry->fields[i] != NULL;
+        if (!used) side_remove(shard, entry);
+    }
+    obj_spin_unlock(&shard->lock);
+    return entry || !value;
+}
+
+/*
+ * The census counts live objects per type and per debug tag. An object
+ * created while it is enabled is allocated with a Census_Slot in front of
+ * it, which points at its census class, the (type, tag) pair of records it
+ * is counted under; the object moves to another class when its type or tag
+ * changes. Objects created with the census off pay nothing. Each thread adds its changes to private per-record deltas
+ * with plain stores and merges a record's delta into the shared counters
+ * every CENSUS_MERGE_EVENTS changes. A delta remembers its highest value
+ * since the last merge, so peaks are exact for a single thread and can only
+ * miss overlapping spikes of several threads. Snapshots add up the shared
+ * counters and every thread's pending deltas. obj_census_lock guards the
+ * record, class and thread lists; records, classes and thread blocks are
+ * never freed.
+ */
+#define CENSUS_BUCKET_COUNT 256
+#define CENSUS_MAX_RECORDS 2048
+#define CENSUS_CHUNK_SIZE 64
+#define CENSUS_MERGE_EVENTS 64
+
+typedef struct s_Census_Counters {
+    intptr_t live_count;
+    intptr_t live_bytes;
+    intptr_t peak_count;
+    intptr_t peak_bytes;
+    intptr_t allocations;
+} Census_Counters;
+
+typedef struct s_Census_Record {
+    struct s_Census_Record* bucket_next;
+    struct s_Census_Record* list_next;  // records of the same kind
+    size_t index;                       // into the per-thread deltas
+    const void* type;                   // NULL for tag records
+    Object_Key tag_hash;
+    const char32_t* name;
+    Census_Counters counters;           // merged deltas
+} Census_Record;
+
+typedef struct s_Obj_Census_Class {
+    struct s_Obj_Census_Class* bucket_next;
+    Census_Record* type;
+    Census_Record* tag;
+} Obj_Census_Class;
 
+// written by the owning thread only, read by snapshots
+typedef struct s_Census_Delta {
+    intptr_t count;
+    intptr_t bytes;
+    intptr_t allocations;
+    intptr_t max_count; // owner only, like the fields below
+    intptr_t max_bytes;
+    size_t events;
+} Census_Delta;
+
+typedef struct s_Census_Thread {
+    struct s_Census_Thread* next;
+    intptr_t chunks[CENSUS_MAX_RECORDS / CENSUS_CHUNK_SIZE]; // Census_Delta[CENSUS_CHUNK_SIZE], allocated on first use
+    intptr_t map_tables;
+    intptr_t map_slots;
+    intptr_t map_items;
+} Census_Thread;
+
+// fixed records, never in the buckets
+static Census_Record obj_census_total = { NULL, NULL, 0, NULL, 0, NULL, { 0 } };
+static Census_Record obj_census_other_types = { NULL, NULL, 1, NULL, 0, U"<other>", { 0 } };  // types past CENSUS_MAX_RECORDS
+static Census_Record obj_census_untyped = { NULL, &obj_census_other_types, 2, NULL, 0, U"<untyped>", { 0 } };
+static Census_Record obj_census_other_tags = { NULL, NULL, 3, NULL, 0, U"<other>", { 0 } };   // tags past CENSUS_MAX_RECORDS
+static Census_Record obj_census_self_tagged = { NULL, &obj_census_other_tags, 4, NULL, 0, U"<data>", { 0 } }; // tagged with their own data, like strings
+static Census_Record obj_census_untagged = { NULL, &obj_census_self_tagged, 5, NULL, 0, U"<untagged>", { 0 } };
+static Obj_Census_Class obj_census_initial_class = { NULL, &obj_census_untyped, &obj_census_untagged };
+
+// sits in front of a counted object and keeps it at the allocator's alignment
+typedef union u_Census_Slot {
+    Obj_Census_Class* census;
+    max_align_t align;
+} Census_Slot;
+
+static intptr_t obj_census_enabled = 0;
+static Obj_Spin_Lock obj_census_lock;
+static Census_Record* obj_census_record_buckets[CENSUS_BUCKET_COUNT];
+static Obj_Census_Class* obj_census_class_buckets[CENSUS_BUCKET_COUNT];
+static Census_Record* obj_census_type_list = &obj_census_untyped;
+static Census_Record* obj_census_tag_list = &obj_census_untagged;
+static size_t obj_census_record_count = 6;
+static Census_Thread* obj_census_threads = NULL;
+static OBJ_THREAD_LOCAL Census_Thread* obj_census_thread = NULL;
+// last retype on this thread, objects of one kind are usually typed in a row
+static OBJ_THREAD_LOCAL Obj_Census_Class* obj_census_retype_from = NULL;
+static OBJ_THREAD_LOCAL const void* obj_census_retype_type = NULL;
+static OBJ_THREAD_LOCAL Obj_Census_Class* obj_census_retype_to = NULL;
+static OBJ_THREAD_LOCAL Obj_Census_Class* obj_census_retag_from = NULL;
+static OBJ_THREAD_LOCAL const char32_t* obj_census_retag_tag = NULL;
+static OBJ_THREAD_LOCAL Obj_Census_Class* obj_census_retag_to = NULL;
+
+static Census_Thread* census_thread() {
+    Census_Thread* thread = obj_census_thread;
+    if (thread) return thread;
+    thread = (Census_Thread*)calloc(1, sizeof(Census_Thread));
+    if (!thread) return NULL;
+    obj_spin_lock(&obj_census_lock);
+    thread->next = obj_census_threads;
+    obj_census_threads = thread;
+    obj_spin_unlock(&obj_census_lock);
+    obj_census_thread = thread;
+    return thread;
+}
+
+static void census_local_add(intptr_t* value, intptr_t delta) {
+    obj_atomic_store_relaxed(value, obj_atomic_load_relaxed(value) + delta);
+}
+
+static void census_raise(intptr_t* peak, intptr_t value) {
+    intptr_t seen = obj_atomic_load_relaxed(peak);
+    while (value > seen) {
+        intptr_t previous = obj_atomic_compare_exchange(peak, seen, value);
+        if (previous == seen) return;
+        seen = previous;
+    }
+}
+
+static void census_merge(Census_Record* record, Census_Delta* delta) {
+    intptr_t count = obj_atomic_load_relaxed(&delta->count);
+    intptr_t bytes = obj_atomic_load_relaxed(&delta->bytes);
+    intptr_t allocations = obj_atomic_load_relaxed(&delta->allocations);
+    obj_atomic_store_relaxed(&delta->count, 0);
+    obj_atomic_store_relaxed(&delta->bytes, 0);
+    obj_atomic_store_relaxed(&delta->allocations, 0);
+    intptr_t live_count = obj_atomic_fetch_add(&record->counters.live_count, count);
+    intptr_t live_bytes = obj_atomic_fetch_add(&record->counters.live_bytes, bytes);
+    if (allocations) obj_atomic_fetch_add(&record->counters.allocations, allocations);
+    census_raise(&record->counters.peak_count, live_count + delta->max_count);
+    census_raise(&record->counters.peak_bytes, live_bytes + delta->max_bytes);
+    delta->max_count = 0;
+    delta->max_bytes = 0;
+    delta->events = 0;
+}
+
+static void census_update(Census_Record* record, intptr_t count, intptr_t bytes) {
+    Census_Thread* thread = census_thread();
+    if (!thread) return;
+    intptr_t* chunk_ref = &thread->chunks[record->index / CENSUS_CHUNK_SIZE];
+    Census_Delta* chunk = (Census_Delta*)*chunk_ref;
+    if (!chunk) {
+        chunk = (Census_Delta*)calloc(CENSUS_CHUNK_SIZE, sizeof(Census_Delta));
+        if (!chunk) return;
+        obj_atomic_store_release(chunk_ref, (intptr_t)chunk);
+    }
+    Census_Delta* delta = &chunk[record->index % CENSUS_CHUNK_SIZE];
+    census_local_add(&delta->count, count);
+    census_local_add(&delta->bytes, bytes);
+    if (count > 0) {
+        census_local_add(&delta->allocations, count);
+        if (delta->count > delta->max_count) delta->max_count = delta->count;
+        if (delta->bytes > delta->max_bytes) delta->max_bytes = delta->bytes;
+    }
+    if (++delta->events >= CENSUS_MERGE_EVENTS) census_merge(record, delta);
+}
+
+static size_t census_bucket(uintptr_t key) {
+    return (size_t)(hash_map_mix((Object_Key)key) % CENSUS_BUCKET_COUNT);
+}
+
+// NULL once CENSUS_MAX_RECORDS records exist
+static Census_Record* census_new_record(const void* type, Object_Key tag_hash, const char32_t* name, Census_Record** list) {
+    if (obj_census_record_count >= CENSUS_MAX_RECORDS) return NULL;
+    Census_Record* record = (Census_Record*)calloc(1, sizeof(Census_Record));
+    if (!record) return NULL;
+    if (name) {
+        size_t size = (u32strlen(name) + 1) * sizeof(char32_t);
+        char32_t* copy = (char32_t*)malloc(size);
+        if (!copy) {
+            free(record);
+            return NULL;
+        }
+        memcpy(copy, name, size);
+        record->name = copy;
+    }
+    record->index = obj_census_record_count++;
+    record->type = type;
+    record->tag_hash = tag_hash;
+    size_t bucket = census_bucket(type ? (uintptr_t)type : (uintptr_t)tag_hash);
+    record->bucket_next = obj_census_record_buckets[bucket];
+    obj_census_record_buckets[bucket] = record;
+    record->list_next = *list;
+    *list = record;
+    return record;
+}
+
+static Census_Record* census_type_record(Object* type) {
+    if (!type) return &obj_census_untyped;
+    for (Census_Record* record = obj_census_record_buckets[census_bucket((uintptr_t)type)]; record; record = record->bucket_next) {
+        if (record->type == type) return record;
+    }
+    Census_Record* record = census_new_record(type, 0, type->debug_tag, &obj_census_type_list);
+    return record ? record : &obj_census_other_types;
+}
+
+static Census_Record* census_tag_record(Object* obj, const char32_t* tag) {
+    if (!tag) return &obj_census_untagged;
+    // strings tag themselves with their content, one record each would be useless
+    if (tag == obj->data) return &obj_census_self_tagged;
+    Object_Key hash = hash_char32_string(NULL, tag);
+    for (Census_Record* record = obj_census_record_buckets[census_bucket((uintptr_t)hash)]; record; record = record->bucket_next) {
+        if (!record->type && record->tag_hash == hash && compare_eq_char32_string(NULL, record->name, tag)) return record;
+    }
+    Census_Record* record = census_new_record(NULL, hash, tag, &obj_census_tag_list);
+    return record ? record : &obj_census_other_tags;
+}
+
+// NULL if the class could not be allocated
+static Obj_Census_Class* census_class(Census_Record* type, Census_Record* tag) {
+    if (type == &obj_census_untyped && tag == &obj_census_untagged) return &obj_census_initial_class;
+    size_t bucket = census_bucket((uintptr_t)type ^ ((uintptr_t)tag << 1));
+    for (Obj_Census_Class* census = obj_census_class_buckets[bucket]; census; census = census->bucket_next) {
+        if (census->type == type && census->tag == tag) return census;
+    }
+    Obj_Census_Class* census = (Obj_Census_Class*)malloc(sizeof(Obj_Census_Class));
+    if (!census) return NULL;
+    census->type = type;
+    census->tag = tag;
+    census->bucket_next = obj_census_class_buckets[bucket];
+    obj_census_class_buckets[bucket] = census;
+    return census;
+}
+
+// only valid for counted objects
+static Census_Slot* census_slot(Object* obj) {
+    return (Census_Slot*)obj - 1;
+}
+
+static void obj_census_add(Object* obj) {
+    intptr_t bytes = (intptr_t)obj->alloc_size;
+    census_slot(obj)->census = &obj_census_initial_class;
+    obj->census_counted = 1;
+    census_update(&obj_census_total, 1, bytes);
+    census_update(&obj_census_untyped, 1, bytes);
+    census_update(&obj_census_untagged, 1, bytes);
+}
+
+static void obj_census_remove(Object* obj) {
+    Obj_Census_Class* census = census_slot(obj)->census;
+    intptr_t bytes = (intptr_t)obj->alloc_size;
+    census_update(&obj_census_total, -1, -bytes);
+    census_update(census->type, -1, -bytes);
+    census_update(census->tag, -1, -bytes);
+    const Object_Hash_Map* map = &obj->attrs_and_children;
+    Census_Thread* thread = census_thread();
+    if (thread) {
+        census_local_add(&thread->map_items, -(intptr_t)map->obj_count);
+        if (map->ctrl) {
+            census_local_add(&thread->map_tables, -1);
+            census_local_add(&thread->map_slots, -(intptr_t)hash_map_capacity(map));
+        }
+    }
+}
+
+static void obj_census_move(Object* obj, Obj_Census_Class* census, Obj_Census_Class* target) {
+    if (!target || target == census) return;
+    intptr_t bytes = (intptr_t)obj->alloc_size;
+    if (target->type != census->type) {
+        census_update(census->type, -1, -bytes);
+        census_update(target->type, 1, bytes);
+    }
+    if (target->tag != census->tag) {
+        census_update(census->tag, -1, -bytes);
+        census_update(target->tag, 1, bytes);
+    }
+    census_slot(obj)->census = target;
+}
+
+static void obj_census_set_type(Object* obj, Object* type) {
+    Obj_Census_Class* census = census_slot(obj)->census;
+    if (census->type->type == type) return;
+    if (obj_census_retype_from != census || obj_census_retype_type != type) {
+        obj_spin_lock(&obj_census_lock);
+        Obj_Census_Class* target = census_class(census_type_record(type), census->tag);
+        obj_spin_unlock(&obj_census_lock);
+        if (!target) return;
+        obj_census_retype_from = census;
+        obj_census_retype_type = type;
+        obj_census_retype_to = target;
+    }
+    obj_census_move(obj, census, obj_census_retype_to);
+}
+
+static void obj_census_set_tag(Object* obj, const char32_t* tag) {
+    Obj_Census_Class* census = census_slot(obj)->census;
+    // the cached class is only reused for the same string, a tag buffer may be refilled
+    int cached = tag && tag != obj->data && obj_census_retag_from == census && obj_census_retag_tag == tag &&
+        obj_census_retag_to->tag->name && compare_eq_char32_string(NULL, obj_census_retag_to->tag->name, tag);
+    if (!cached) {
+        obj_spin_lock(&obj_census_lock);
+        Obj_Census_Class* target = census_class(census->type, census_tag_record(obj, tag));
+        obj_spin_unlock(&obj_census_lock);
+        if (!target) return;
+        obj_census_retag_from = census;
+        obj_census_retag_tag = tag;
+        obj_census_retag_to = target;
+    }
+    obj_census_move(obj, census, obj_census_retag_to);
+}
+
+// attribute maps of counted objects feed the map totals
+static void obj_census_map_changed(Object* obj, size_t old_count, size_t old_capacity) {
+    const Object_Hash_Map* map = &obj->attrs_and_children;
+    size_t capacity = hash_map_capacity(map);
+    if (map->obj_count == old_count && capacity == old_capacity) return;
+    Census_Thread* thread = census_thread();
+    if (!thread) return;
+    census_local_add(&thread->map_items, (intptr_t)map->obj_count - (intptr_t)old_count);
+    if (capacity != old_capacity) {
+        census_local_add(&thread->map_slots, (intptr_t)capacity - (intptr_t)old_capacity);
+        if (!old_capacity) census_local_add(&thread->map_tables, 1);
+        else if (!capacity) census_local_add(&thread->map_tables, -1);
+    }
+}
+
+// called with obj_census_lock held; other threads may be mid-merge, so
+// values can be off by one batch while they are running
+static Obj_Census_Counters census_read(Census_Record* record) {
+    intptr_t count = obj_atomic_load_relaxed(&record->counters.live_count);
+    intptr_t bytes = obj_atomic_load_relaxed(&record->counters.live_bytes);
+    intptr_t allocations = obj_atomic_load_relaxed(&record->counters.allocations);
+    for (Census_Thread* thread = obj_census_threads; thread; thread = thread->next) {
+        Census_Delta* chunk = (Census_Delta*)obj_atomic_load_acquire(&thread->chunks[record->index / CENSUS_CHUNK_SIZE]);
+        if (!chunk) continue;
+        Census_Delta* delta = &chunk[record->index % CENSUS_CHUNK_SIZE];
+        count += obj_atomic_load_relaxed(&delta->count);
+        bytes += obj_atomic_load_relaxed(&delta->bytes);
+        allocations += obj_atomic_load_relaxed(&delta->allocations);
+    }
+    if (count < 0) count = 0;
+    if (bytes < 0) bytes = 0;
+    intptr_t peak_count = obj_atomic_load_relaxed(&record->counters.peak_count);
+    intptr_t peak_bytes = obj_atomic_load_relaxed(&record->counters.peak_bytes);
+    Obj_Census_Counters result;
+    result.live_count = (size_t)count;
+    result.live_bytes = (size_t)bytes;
+    result.peak_count = (size_t)(peak_count > count ? peak_count : count);
+    result.peak_bytes = (size_t)(peak_bytes > bytes ? peak_bytes : bytes);
+    result.allocations = (size_t)allocations;
+    return result;
+}
+
+static size_t census_copy_records(Census_Record* const* list, Obj_Census_Record* records, size_t max_records) {
+    size_t count = 0;
+    obj_spin_lock(&obj_census_lock);
+    for (Census_Record* record = *list; record; record = record->list_next) {
+        if (count < max_records) {
+            records[count].type = record->type;
+            records[count].name = record->name;
+            records[count].counters = census_read(record);
+        }
+        count++;
+    }
+    obj_spin_unlock(&obj_census_lock);
+    return count;
+}
+
+void obj_set_census(int enabled) {
+    obj_atomic_store_release(&obj_census_enabled, enabled ? 1 : 0);
+}
+
+Obj_Census_Totals obj_get_census_totals() {
+    Obj_Census_Totals totals;
+    intptr_t tables = 0, slots = 0, items = 0;
+    obj_spin_lock(&obj_census_lock);
+    totals.objects = census_read(&obj_census_total);
+    for (Census_Thread* thread = obj_census_threads; thread; thread = thread->next) {
+        tables += obj_atomic_load_relaxed(&thread->map_tables);
+        slots += obj_atomic_load_relaxed(&thread->map_slots);
+        items += obj_atomic_load_relaxed(&thread->map_items);
+    }
+    obj_spin_unlock(&obj_census_lock);
+    totals.map_tables = tables > 0 ? (size_t)tables : 0;
+    totals.map_slots = slots > 0 ? (size_t)slots : 0;
+    totals.map_items = items > 0 ? (size_t)items : 0;
+    totals.map_bytes = totals.map_slots * (sizeof(Object_Key) + sizeof(Object*) + 1);
+    totals.timestamp_ns = obj_now_ns();
+    return totals;
+}
+
+size_t obj_get_census_types(Obj_Census_Record* records, size_t max_records) {
+    return census_copy_records(&obj_census_type_list, records, max_records);
+}
+
+size_t obj_get_census_tags(Obj_Census_Record* records, size_t max_records) {
+    return census_copy_records(&obj_census_tag_list, records, max_records);
 }
 
 Object* obj_create(size_t size, size_t align_req) {
@@ -219,41 +1934,56 @@ Object* obj_create(size_t size, size_t align_req) {
     size_t base_size = sizeof(Object);
     size_t padding = (align_req - (base_size % align_req)) % align_req;
     if (size == 0) padding = 0;
-    Object* obj = (Object*)obj_mem_allocate(base_size + padding + size);
-    if (!obj) return NULL;
-    obj->attrs_and_children.buckets = NULL;
-    obj->attrs_and_children.bucket_count_log2 = 0;
-    obj->attrs_and_children.obj_count = 0;
+    int counted = obj_atomic_load_relaxed(&obj_census_enabled) != 0;
+    size_t prefix = counted ? sizeof(Census_Slot) : 0;
+    size_t alloc_size = prefix + base_size + padding + size;
+    char* memory = (char*)obj_mem_allocate(alloc_size);
+    if (!memory) return NULL;
+    Object* obj = (Object*)(memory + prefix);
+    memset(&obj->attrs_and_children, 0, sizeof(Object_Hash_Map));
     obj->parent = NULL;
     if (size) obj->data = (char*)obj + base_size + padding;
     else obj->data = NULL;
     obj->data_size = 0; // 0 for static memory
     obj->ref_count = 0;
+#ifdef OBJ_BIASED_REFCOUNT
+    Obj_Ref_Owner* owner = obj_create_thread_owner();
+    if (owner && obj_atomic_load_relaxed(&owner->merge_queue)) obj_merge_shared_refs();
+    obj->shared_ref_count = owner ? 0 : OBJ_SHARED_REF_MERGED;
+    obj->owner_thread = owner;
+#endif
     obj->debug_tag = NULL;
+    obj->alloc_size = alloc_size;
+    obj->census_counted = 0;
+    obj->change_tracked = 0;
+    if (counted) obj_census_add(obj);
     return obj;
 }
 
 static void obj_clear_attr(Object* obj) {
     if (!obj) return;
-    if (obj->attrs_and_children.buckets) {
-        for (size_t i = 0; i < obj->attrs_and_children.bucket_count_log2; i++) {
-            Object_Hash_Item* item = obj->attrs_and_children.buckets[i];
-            while (item) {
-                Object_Hash_Item* next = item->next;
-                obj_dec_ref(item->value);
-                item = next;
-            }
+    Object_Hash_Map map = obj->attrs_and_children;
+    // detach first so destructors running below never see a half-freed table
+    memset(&obj->attrs_and_children, 0, sizeof(Object_Hash_Map));
+    for (int i = 0; i < OBJ_INLINE_ATTR_COUNT; i++) {
+        obj_dec_ref(map.inline_values[i]);
+    }
+    if (map.ctrl) {
+        size_t capacity = hash_map_capacity(&map);
+        for (size_t i = 0; i < capacity; i++) {
+            if (map.ctrl[i] & 0x80) continue;
+            obj_dec_ref(map.values[i]);
         }
-        free(obj->attrs_and_children.buckets);
+        free_hash_map(&map);
     }
-    obj->attrs_and_children.buckets = NULL;
-    obj->attrs_and_children.bucket_count_log2 = 0;
-    obj->attrs_and_children.obj_count = 0;
 }
 
 void obj_reset(Object* obj) {
     if (!obj) return;
-    Closure_Data* destruct_func = obj_query_method(obj, OBJ_DESTRUCT_FUNCTION_KEY);
+    // a type's own destructor attribute is for its instances, so only the type's counts here
+    Object* type = obj_get_type(obj);
+    Object* destruct_obj = type ? obj_get_attr_internal(&type->attrs_and_children, OBJ_DESTRUCT_FUNCTION_KEY) : NULL;
+    Closure_Data* destruct_func = destruct_obj ? destruct_obj->data : NULL;
     if (destruct_func) {
         ((Object_Destruct_Function)destruct_func->func)(destruct_func, obj);
     }else if (obj->data_size > 0) {
@@ -263,28 +1993,120 @@ void obj_reset(Object* obj) {
     obj->data = NULL;
 }
 
+/*
+ * Releasing an object releases its attributes and, through destructors such
+ * as the map and array ones, its children. Instead of recursing, obj_free()
+ * pushes dead objects onto a per-thread stack (linked through the now unused
+ * parent field) that the outermost call unwinds, so stack depth no longer
+ * follows tree depth. In deferred mode dead objects go to a shared FIFO that
+ * the application drains with obj_drain_deferred_free() under a budget.
+ */
+static OBJ_THREAD_LOCAL Object* obj_free_pending = NULL;
+static OBJ_THREAD_LOCAL int obj_free_unwinding = 0;
+
+static Obj_Spin_Lock obj_deferred_lock;
+static intptr_t obj_deferred_enabled = 0;
+static Object* obj_deferred_head = NULL;
+static Object* obj_deferred_tail = NULL;
+static Obj_Free_Queue_Stats obj_deferred_stats = { 0 };
+
+static void obj_track_free(Object* obj);
+
+static void obj_destroy(Object* obj) {
+    obj_reset(obj);
+    if (obj->census_counted) obj_census_remove(obj);
+    if (obj->attrs_and_children.obj_count) obj_clear_attr(obj);
+    if (obj->change_tracked) obj_track_free(obj);
+    obj_mem_deallocate(obj->census_counted ? (void*)census_slot(obj) : (void*)obj);
+}
+
 static void obj_free(Object* obj) {
     if (!obj) return;
     if (obj->ref_count > 0) return;
-    obj_reset(obj);
-    if (obj->attrs_and_children.buckets) obj_clear_attr(obj);
-    obj_mem_deallocate(obj);
+    if (obj_atomic_load_relaxed(&obj_deferred_enabled)) {
+        obj->parent = NULL;
+        obj_spin_lock(&obj_deferred_lock);
+        if (obj_deferred_tail) obj_deferred_tail->parent = obj;
+        else obj_deferred_head = obj;
+        obj_deferred_tail = obj;
+        obj_deferred_stats.depth++;
+        obj_deferred_stats.total_deferred++;
+        if (obj_deferred_stats.depth > obj_deferred_stats.peak_depth) obj_deferred_stats.peak_depth = obj_deferred_stats.depth;
+        obj_spin_unlock(&obj_deferred_lock);
+        return;
+    }
+    obj->parent = obj_free_pending;
+    obj_free_pending = obj;
+    if (obj_free_unwinding) return; // an outer obj_free() on this thread picks it up
+    obj_free_unwinding = 1;
+    while (obj_free_pending) {
+        Object* next = obj_free_pending;
+        obj_free_pending = next->parent;
+        obj_destroy(next);
+    }
+    obj_free_unwinding = 0;
+}
+
+void obj_set_deferred_free(int enabled) {
+    obj_atomic_store_release(&obj_deferred_enabled, enabled ? 1 : 0);
+}
+
+size_t obj_drain_deferred_free(size_t max_objects, uint64_t max_nanoseconds) {
+    uint64_t deadline = max_nanoseconds ? obj_now_ns() + max_nanoseconds : 0;
+    size_t destroyed = 0;
+    while (!max_objects || destroyed < max_objects) {
+        // reading the clock costs more than a small object, so check it in batches
+        if (deadline && destroyed % 32 == 31 && obj_now_ns() >= deadline) break;
+        obj_spin_lock(&obj_deferred_lock);
+        Object* obj = obj_deferred_head;
+        if (obj) {
+            obj_deferred_head = obj->parent;
+            if (!obj_deferred_head) obj_deferred_tail = NULL;
+            obj_deferred_stats.depth--;
+            obj_deferred_stats.total_destroyed++;
+        }
+        obj_spin_unlock(&obj_deferred_lock);
+        if (!obj) break;
+        obj_destroy(obj); // children that die here are queued behind it
+        destroyed++;
+    }
+    return destroyed;
+}
+
+Obj_Free_Queue_Stats obj_get_free_queue_stats() {
+    obj_spin_lock(&obj_deferred_lock);
+    Obj_Free_Queue_Stats stats = obj_deferred_stats;
+    obj_spin_unlock(&obj_deferred_lock);
+    return stats;
 }
 
 Object* obj_get_type(Object* obj) {
     return obj_get_attr_internal(&obj->attrs_and_children, OBJ_TYPE_KEY);
 }
 
+static void obj_add_attr_counted(Object* obj, Object_Key key, Object* value) {
+    if (!obj->census_counted) {
+        obj_add_attr_internal(&obj->attrs_and_children, key, value);
+        return;
+    }
+    size_t count = obj->attrs_and_children.obj_count;
+    size_t capacity = hash_map_capacity(&obj->attrs_and_children);
+    obj_add_attr_internal(&obj->attrs_and_children, key, value);
+    obj_census_map_changed(obj, count, capacity);
+}
+
 void obj_set_type(Object* obj, Object* type) {
     if (!obj) return;
     if (!type) return;
-    obj_add_attr_internal(&obj->attrs_and_children, OBJ_TYPE_KEY, type);
+    if (obj->census_counted) obj_census_set_type(obj, type);
+    obj_add_attr_counted(obj, OBJ_TYPE_KEY, type);
 }
 
 void obj_add_attr(Object* obj, Object_Key key, Object* value) {
     if (!obj) return;
     if (!value) return;
-    obj_add_attr_internal(&obj->attrs_and_children, key, value);
+    obj_add_attr_counted(obj, key, value);
+    if (obj->change_tracked) obj_note_change(obj);
 }
 
 Object* obj_get_attr(Object* obj, Object_Key key) {
@@ -292,49 +2114,257 @@ Object* obj_get_attr(Object* obj, Object_Key key) {
     return obj_get_attr_internal(&obj->attrs_and_children, key);
 }
 
+int obj_remove_attr(Object* obj, Object_Key key) {
+    if (!obj) return 0;
+    size_t count = obj->attrs_and_children.obj_count;
+    size_t capacity = hash_map_capacity(&obj->attrs_and_children);
+    Object* value = obj_remove_attr_internal(&obj->attrs_and_children, key);
+    if (!value) return 0;
+    if (obj->census_counted) obj_census_map_changed(obj, count, capacity);
+    if (obj->change_tracked) obj_note_change(obj);
+    obj_dec_ref(value);
+    return 1;
+}
+
+typedef struct s_Obj_Change_Subscriber {
+    Obj_Change_Callback callback;
+    void* context;
+    size_t id;
+} Obj_Change_Subscriber;
+
+// the parent's tracker is looked up once when linking, so a walk up the
+// tree goes to the side table only for the object it starts at
+typedef struct s_Obj_Change_Parent {
+    Object* obj;
+    struct s_Obj_Change_Tracker* tracker;
+} Obj_Change_Parent;
+
+typedef struct s_Obj_Change_Tracker {
+    uint64_t generation;    // of the last change to the object or below it
+    int dirty;
+    Obj_Change_Parent* parents; // borrowed; a container holding the object twice lists itself twice
+    size_t parent_count;
+    size_t parent_capacity;
+    Obj_Change_Subscriber* subscribers;
+    size_t subscriber_count;
+    size_t subscriber_capacity;
+} Obj_Change_Tracker;
+
+static intptr_t obj_change_generation_counter = 0;
+static intptr_t obj_change_subscription_counter = 0;
+
+// grows items to hold one more, returns 0 when out of memory
+static int obj_track_grow(void** items, size_t* capacity, size_t count, size_t item_size) {
+    if (count < *capacity) return 1;
+    size_t new_capacity = *capacity ? *capacity * 2 : 4;
+    void* grown = realloc(*items, new_capacity * item_size);
+    if (!grown) return 0;
+    *items = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static uint64_t obj_next_change_generation() {
+    return (uint64_t)obj_atomic_fetch_add(&obj_change_generation_counter, 1) + 1;
+}
+
+// NULL unless obj is tracked
+static Obj_Change_Tracker* obj_tracker(Object* obj) {
+    return obj->change_tracked ? (Obj_Change_Tracker*)obj_side_get(obj, OBJ_SIDE_TRACKER) : NULL;
+}
+
+static void obj_track_free(Object* obj) {
+    Obj_Change_Tracker* tracker = obj_tracker(obj);
+    obj_side_set(obj, OBJ_SIDE_TRACKER, NULL);
+    obj->change_tracked = 0;
+    free(tracker->parents);
+    free(tracker->subscribers);
+    free(tracker);
+}
+
+int obj_track_changes(Object* obj) {
+    if (!obj || obj->change_tracked) return 0;
+    Obj_Change_Tracker* tracker = (Obj_Change_Tracker*)calloc(1, sizeof(Obj_Change_Tracker));
+    if (!tracker) return 0;
+    tracker->generation = obj_next_change_generation();
+    tracker->dirty = 1;
+    if (!obj_side_set(obj, OBJ_SIDE_TRACKER, tracker)) {
+        free(tracker);
+        return 0;
+    }
+    obj->change_tracked = 1;
+    return 1;
+}
+
+int obj_track_link(Object* parent, Object* child) {
+    if (!parent || !child) return 0;
+    Obj_Change_Tracker* parent_tracker = obj_tracker(parent);
+    if (!parent_tracker) return 0;
+    int added = obj_track_changes(child);
+    Obj_Change_Tracker* tracker = obj_tracker(child);
+    if (!tracker) return 0;
+    if (!obj_track_grow((void**)&tracker->parents, &tracker->parent_capacity, tracker->parent_count, sizeof(Obj_Change_Parent))) return added;
+    Obj_Change_Parent link = { parent, parent_tracker };
+    tracker->parents[tracker->parent_count++] = link;
+    return added;
+}
+
+void obj_track_unlink(Object* parent, Object* child) {
+    if (!parent || !child) return;
+    Obj_Change_Tracker* tracker = obj_tracker(child);
+    if (!tracker) return;
+    for (size_t i = tracker->parent_count; i > 0; i--) {
+        if (tracker->parents[i - 1].obj != parent) continue;
+        tracker->parents[i - 1] = tracker->parents[--tracker->parent_count];
+        return;
+    }
+}
+
+// walks up through the first parent and recurses only where a tracked
+// object has several, so the stack does not grow with the tree's depth
+static void obj_track_mark(Object* obj, Obj_Change_Tracker* tracker, Object* changed, uint64_t generation) {
+    while (obj) {
+        if (tracker->generation == generation) return; // reached through another parent already
+        tracker->generation = generation;
+        tracker->dirty = 1;
+        // by index, a callback may subscribe or unsubscribe
+        for (size_t i = 0; i < tracker->subscriber_count; i++) {
+            Obj_Change_Subscriber subscriber = tracker->subscribers[i];
+            subscriber.callback(subscriber.context, obj, changed);
+        }
+        Obj_Change_Parent next = { NULL, NULL };
+        for (size_t i = 0; i < tracker->parent_count; i++) {
+            if (!next.obj) next = tracker->parents[i];
+            else obj_track_mark(tracker->parents[i].obj, tracker->parents[i].tracker, changed, generation);
+        }
+        obj = next.obj;
+        tracker = next.tracker;
+    }
+}
+
+uint64_t obj_note_change(Object* obj) {
+    if (!obj) return 0;
+    Obj_Change_Tracker* tracker = obj_tracker(obj);
+    if (!tracker) return 0;
+    uint64_t generation = obj_next_change_generation();
+    obj_track_mark(obj, tracker, obj, generation);
+    return generation;
+}
+
+uint64_t obj_change_generation(Object* obj) {
+    Obj_Change_Tracker* tracker = obj ? obj_tracker(obj) : NULL;
+    return tracker ? tracker->generation : 0;
+}
+
+uint64_t obj_current_change_generation() {
+    return (uint64_t)obj_atomic_load_relaxed(&obj_change_generation_counter);
+}
+
+int obj_is_dirty(Object* obj) {
+    Obj_Change_Tracker* tracker = obj ? obj_tracker(obj) : NULL;
+    return tracker && tracker->dirty;
+}
+
+void obj_clear_dirty(Object* obj) {
+    Obj_Change_Tracker* tracker = obj ? obj_tracker(obj) : NULL;
+    if (tracker) tracker->dirty = 0;
+}
+
+size_t obj_subscribe(Object* obj, Obj_Change_Callback callback, void* context) {
+    if (!obj || !callback) return 0;
+    obj_track_changes(obj);
+    Obj_Change_Tracker* tracker = obj_tracker(obj);
+    if (!tracker) return 0;
+    if (!obj_track_grow((void**)&tracker->subscribers, &tracker->subscriber_capacity, tracker->subscriber_count, sizeof(Obj_Change_Subscriber))) return 0;
+    size_t id = (size_t)obj_atomic_fetch_add(&obj_change_subscription_counter, 1) + 1;
+    Obj_Change_Subscriber subscriber = { callback, context, id };
+    tracker->subscribers[tracker->subscriber_count++] = subscriber;
+    return id;
+}
+
+void obj_unsubscribe(Object* obj, size_t subscription) {
+    if (!obj) return;
+    Obj_Change_Tracker* tracker = obj_tracker(obj);
+    if (!tracker) return;
+    for (size_t i = 0; i < tracker->subscriber_count; i++) {
+        if (tracker->subscribers[i].id != subscription) continue;
+        // keeps the order subscribers are called in
+        memmove(&tracker->subscribers[i], &tracker->subscribers[i + 1], (tracker->subscriber_count - i - 1) * sizeof(Obj_Change_Subscriber));
+        tracker->subscriber_count--;
+        return;
+    }
+}
+
+// slots [0, OBJ_INLINE_ATTR_COUNT) are the inline pairs, table slot i follows as OBJ_INLINE_ATTR_COUNT + i
+static int obj_attr_iter_valid(Object_Attr_Iterator iter) {
+    const Object_Hash_Map* map = &iter.obj->attrs_and_children;
+    if (iter.slot < OBJ_INLINE_ATTR_COUNT) return map->inline_values[iter.slot] != NULL;
+    return !(map->ctrl[iter.slot - OBJ_INLINE_ATTR_COUNT] & 0x80);
+}
+
 Object_Attr_Iterator obj_attr_iter_begin(Object* obj) {
     Object_Attr_Iterator iter;
     iter.obj = obj;
-    iter.bucket_index = 0;
-    iter.item = NULL;
+    iter.slot = 0;
+    if (!obj) return iter;
+    if (obj_attr_iter_valid(iter)) return iter;
     return obj_attr_iter_next(iter);
 }
 
 Object_Attr_Iterator obj_attr_iter_end(Object* obj) {
     Object_Attr_Iterator iter;
     iter.obj = obj;
-    iter.bucket_index = (size_t)1 << obj->attrs_and_children.bucket_count_log2;
-    iter.item = NULL;
+    iter.slot = obj ? OBJ_INLINE_ATTR_COUNT + hash_map_capacity(&obj->attrs_and_children) : 0;
     return iter;
 }
 
 Object_Attr_Iterator obj_attr_iter_next(Object_Attr_Iterator iter) {
     if (!iter.obj) return iter;
-    if (!iter.obj->attrs_and_children.buckets) return iter; // empty
-    if (iter.item) {
-        iter.item = iter.item->next;
-        if (iter.item) return iter; // same bucket
+    size_t end = OBJ_INLINE_ATTR_COUNT + hash_map_capacity(&iter.obj->attrs_and_children);
+    if (iter.slot >= end) return iter;
+    iter.slot++;
+    while (iter.slot < OBJ_INLINE_ATTR_COUNT) {
+        if (obj_attr_iter_valid(iter)) return iter;
+        iter.slot++;
     }
-    else if (iter.bucket_index == 0)
-    {
-        // first bucket
-        iter.item = iter.obj->attrs_and_children.buckets[iter.bucket_index];
-        if (iter.item) return iter;
-    }
-    while (iter.bucket_index < ((size_t)1 << iter.obj->attrs_and_children.bucket_count_log2)) {
-        iter.item = iter.obj->attrs_and_children.buckets[iter.bucket_index++];
-        if (iter.item) return iter;
+    const uint8_t* ctrl = iter.obj->attrs_and_children.ctrl;
+    // skip whole groups of free slots at a time
+    while (iter.slot < end) {
+        size_t slot = iter.slot - OBJ_INLINE_ATTR_COUNT;
+        if (slot % HASH_MAP_GROUP_WIDTH == 0) {
+            uint32_t full = ~hash_map_group_match_free(ctrl + slot) & 0xFFFF;
+            if (!full) {
+                iter.slot += HASH_MAP_GROUP_WIDTH;
+                continue;
+            }
+            iter.slot += hash_map_ctz(full);
+            return iter;
+        }
+        if (!(ctrl[slot] & 0x80)) return iter;
+        iter.slot++;
     }
+    iter.slot = end;
     return iter;
 }
 
 int obj_attr_iter_equal(Object_Attr_Iterator iter1, Object_Attr_Iterator iter2) {
     if (iter1.obj != iter2.obj) return 0;
-    if (iter1.bucket_index != iter2.bucket_index) return 0;
-    if (iter1.item != iter2.item) return 0;
+    if (iter1.slot != iter2.slot) return 0;
     return 1;
 }
 
+Object_Key obj_attr_iter_key(Object_Attr_Iterator iter) {
+    const Object_Hash_Map* map = &iter.obj->attrs_and_children;
+    if (iter.slot < OBJ_INLINE_ATTR_COUNT) return map->inline_keys[iter.slot];
+    return map->keys[iter.slot - OBJ_INLINE_ATTR_COUNT];
+}
+
+Object* obj_attr_iter_value(Object_Attr_Iterator iter) {
+    const Object_Hash_Map* map = &iter.obj->attrs_and_children;
+    if (iter.slot < OBJ_INLINE_ATTR_COUNT) return map->inline_values[iter.slot];
+    return map->values[iter.slot - OBJ_INLINE_ATTR_COUNT];
+}
+
 char* obj_str32_to_utf8(const char32_t* u32str) {
     mbstate_t state = { 0 };
     const char32_t* p = u32str;
@@ -370,6 +2400,33 @@ char* obj_str32_to_utf8(const char32_t* u32str) {
     return utf8;
 }
 
+Object* obj_create_compact_string(const char32_t* str) {
+    String_View view = { str, u32strlen(str), sizeof(char32_t) };
+    if (view.length > UINT32_MAX) return NULL;
+    size_t width = string_view_narrowest_width(&view);
+    Object* obj = obj_create(compact_string_size(view.length, width), _Alignof(Obj_Compact_String));
+    if (!obj) return NULL;
+    compact_string_fill(obj->data, &view, width);
+    obj_set_type(obj, obj_compact_string_type_obj);
+    return obj;
+}
+
+char32_t obj_compact_string_at(const Obj_Compact_String* str, size_t index) {
+    String_View view = compact_string_view(str);
+    return string_view_at(&view, index);
+}
+
+char* obj_compact_string_to_utf8(const Obj_Compact_String* str) {
+    char32_t* wide = malloc((str->length + 1) * sizeof(char32_t));
+    if (!wide) return NULL;
+    String_View view = compact_string_view(str);
+    string_view_widen(&view, 0, str->length, wide);
+    wide[str->length] = 0;
+    char* utf8 = obj_str32_to_utf8(wide);
+    free(wide);
+    return utf8;
+}
+
 void obj_debug_set_allocator(void* (*allocate)(size_t size), void(*deallocate)(void*))
 {
     obj_mem_allocate = allocate;
@@ -378,6 +2435,7 @@ void obj_debug_set_allocator(void* (*allocate)(size_t size), void(*deallocate)(v
 
 void obj_debug_add_tag(Object* obj, const char32_t* tag)
 {
+    if (obj->census_counted) obj_census_set_tag(obj, tag);
     obj->debug_tag = tag;
 }
 
@@ -8,10 +8,16 @@
  * for the Easy Direct Composition library.
  *
  * Features:
- * - Reference counting for automatic memory management
- * - Hash-based attribute storage
+ * - Reference counting for automatic memory management, optionally biased
+ *   towards the creating thread (OBJ_BIASED_REFCOUNT) for cross-thread use
+ * - Hash-based attribute storage (open addressing, SIMD group probing)
  * - Type system with custom destructors
- * - UTF-32 string support
+ * - UTF-32 strings, and compact strings stored 1, 2 or 4 bytes per character
+ * - Iterative destruction with an optional budgeted deferred-free queue
+ * - Interned keys that are reclaimed when no longer looked up
+ * - Opt-in census of live objects and bytes per type and debug tag
+ * - Opt-in change tracking: dirty flags and generations that propagate to
+ *   containing objects, and change subscribers
  * - Debug support with object tagging
  */
 
@@ -27,7 +33,14 @@
 extern "C" {
 #endif
 
+// smallest table is one 16-slot probe group; tables grow at 7/8 load and
+// shrink when obj_count drops below capacity / OBJ_HASH_MAP_MIN_LOAD_DIV
 #define OBJ_DEFAULT_BUCKET_COUNT_LOG2 4
+#define OBJ_HASH_MAP_MIN_LOAD_DIV 4
+// attributes kept inside the object itself before a table is allocated
+#define OBJ_INLINE_ATTR_COUNT 4
+// the top bits of Object::alloc_size are flags
+#define OBJ_ALLOC_SIZE_BITS (sizeof(size_t) * CHAR_BIT - 2)
 #define OBJ_KEY_HASH_FLAG INTPTR_MIN
 #define OBJ_KEY_IS_HASH(key) ((key) & OBJ_KEY_HASH_FLAG)
 #define OBJ_KEY_IS_CHILD(key) (!OBJ_KEY_IS_HASH(key))
@@ -41,21 +54,25 @@ extern "C" {
     typedef Object_Key(*Object_Key_Hash_Function)(struct s_Closure_Data* self, void* obj_data);
     typedef int (*Object_Key_Compare_Equal_Function)(struct s_Closure_Data* self, void* obj_data1, void* obj_data2);
     typedef void (*Object_Destruct_Function)(struct s_Closure_Data* self, struct s_Object* obj);
+    // observed is the subscribed object, changed the one that was mutated: observed or an object linked below it
+    typedef void (*Obj_Change_Callback)(void* context, struct s_Object* observed, struct s_Object* changed);
 
     typedef struct s_Closure_Data {
         void* func;
     } Closure_Data;
 
-    typedef struct s_Object_Hash_Item {
-        Object_Key key;
-        struct s_Object* value;
-        struct s_Object_Hash_Item* next;
-    } Object_Hash_Item;
-
+    // the first OBJ_INLINE_ATTR_COUNT attributes live inline, the rest spill into
+    // an open-addressing table whose keys and values live in parallel arrays
     typedef struct s_Object_Hash_Map {
-        Object_Hash_Item** buckets;
-        size_t bucket_count_log2;
-        size_t obj_count;
+        Object_Key inline_keys[OBJ_INLINE_ATTR_COUNT];
+        struct s_Object* inline_values[OBJ_INLINE_ATTR_COUNT]; // NULL marks a free inline slot
+        uint8_t* ctrl;              // one control byte per slot, NULL until the first spill
+        Object_Key* keys;
+        struct s_Object** values;
+        size_t bucket_count_log2;   // log2 of the slot count
+        size_t table_count;         // attributes stored in the table
+        size_t growth_left;         // EMPTY slots that may still be filled before a rehash
+        size_t obj_count;           // inline and table attributes together
     } Object_Hash_Map;
 
     typedef struct s_Object {
@@ -63,14 +80,68 @@ extern "C" {
         struct s_Object* parent; //nullable
         void* data;         // NULL for empty object
         size_t data_size;   // 0 for static memory
-        size_t ref_count;
+        size_t ref_count;   // biased count owned by owner_thread when OBJ_BIASED_REFCOUNT is set
+#ifdef OBJ_BIASED_REFCOUNT
+        intptr_t shared_ref_count;  // references taken by other threads, see obj_share()
+        const void* owner_thread;
+#endif
         const char32_t* debug_tag;
+        size_t alloc_size : OBJ_ALLOC_SIZE_BITS; // bytes requested from the allocator for the object and its inline data
+        size_t census_counted : 1;  // created while the census was enabled, its class is in a slot in front of it
+        size_t change_tracked : 1;  // obj_track_changes() was called, the tracker is kept in a side table
     } Object;
 
+    typedef struct s_Obj_Free_Queue_Stats {
+        size_t depth;           // objects waiting in the deferred queue
+        size_t peak_depth;
+        size_t total_deferred;  // objects ever queued
+        size_t total_destroyed; // objects destroyed by obj_drain_deferred_free()
+    } Obj_Free_Queue_Stats;
+
+    // a compact string keeps every code point in the narrowest width (1, 2 or
+    // 4 bytes) that fits the whole string; the NUL-terminated characters
+    // follow this header in the object's data
+    typedef struct s_Obj_Compact_String {
+        uint32_t length;    // code points, without the terminator
+        uint32_t width;     // bytes per code point
+    } Obj_Compact_String;
+
+    typedef struct s_Obj_Census_Counters {
+        size_t live_count;
+        size_t live_bytes;  // object allocations, attribute tables are in Obj_Census_Totals
+        size_t peak_count;
+        size_t peak_bytes;
+        size_t allocations; // objects ever counted here, diff two snapshots for a rate
+    } Obj_Census_Counters;
+
+    typedef struct s_Obj_Census_Record {
+        const void* type;       // type object of a per-type record, NULL for untyped and per-tag ones
+        const char32_t* name;   // the tag, or the type's tag when it was first seen; may be NULL
+        Obj_Census_Counters counters;
+    } Obj_Census_Record;
+
+    typedef struct s_Obj_Census_Totals {
+        Obj_Census_Counters objects;
+        size_t map_tables;  // attribute tables allocated once the inline slots overflowed
+        size_t map_slots;
+        size_t map_items;   // inline and table attributes
+        size_t map_bytes;
+        uint64_t timestamp_ns;
+    } Obj_Census_Totals;
+
+    typedef struct s_Obj_Intern_Stats {
+        size_t live_keys;       // texts and objects a lookup can still find
+        size_t pinned_keys;     // of those, never reclaimed by a sweep
+        size_t vacant_slots;    // left by sweeps until the table is next rebuilt
+        size_t capacity;        // slots in the current table
+        size_t bytes;           // entries and tables, including retired memory not yet released
+        size_t reclaimed_keys;  // entries ever freed by obj_sweep_interned_keys()
+    } Obj_Intern_Stats;
+
+    // iterators are invalidated by any insertion or removal on obj
     typedef struct s_Object_Attr_Iterator {
         Object* obj;
-        size_t bucket_index;
-        Object_Hash_Item* item;
+        size_t slot;
     } Object_Attr_Iterator;
 
     void obj_init_key_map();
@@ -78,14 +149,75 @@ extern "C" {
     Object* obj_create(size_t size, size_t align_req);
     void obj_add_attr(Object* obj, Object_Key key, Object* value);
     Object* obj_get_attr(Object* obj, Object_Key key);
+    int obj_remove_attr(Object* obj, Object_Key key);
     void obj_reset(Object* obj);
     void obj_inc_ref(Object* obj);
     void obj_dec_ref(Object* obj);
+    // obj_inc_ref/obj_dec_ref on each of count objects (NULL entries are
+    // skipped), with one count update per run of the same object
+    void obj_inc_refs(Object* const* objs, size_t count);
+    void obj_dec_refs(Object* const* objs, size_t count);
+    // with OBJ_BIASED_REFCOUNT, moves the owner's references into the shared
+    // count; call before handing obj to a thread that may drop the last one.
+    // Without it, a reference released by another thread leaves the object
+    // queued on its owner until the owner merges (see below)
+    void obj_share(Object* obj);
+    // with OBJ_BIASED_REFCOUNT, settles objects of this thread whose references
+    // other threads released, freeing those that are no longer referenced.
+    // obj_create() does it too, so only threads that stop creating objects
+    // need to call it; objects of a thread that has exited stay queued.
+    // Returns how many objects were settled
+    size_t obj_merge_shared_refs(void);
+    // while enabled, objects whose last reference is dropped are only queued;
+    // obj_drain_deferred_free() destroys at most max_objects of them, or stops
+    // after max_nanoseconds (0 means no limit for either)
+    void obj_set_deferred_free(int enabled);
+    size_t obj_drain_deferred_free(size_t max_objects, uint64_t max_nanoseconds);
+    Obj_Free_Queue_Stats obj_get_free_queue_stats();
+    // only objects created while the census is enabled are counted, until they
+    // die; types are told apart by address and records are never freed.
+    // obj_get_census_types/tags copy up to max_records and return how many exist
+    void obj_set_census(int enabled);
+    Obj_Census_Totals obj_get_census_totals();
+    size_t obj_get_census_types(Obj_Census_Record* records, size_t max_records);
+    size_t obj_get_census_tags(Obj_Census_Record* records, size_t max_records);
+
+    // change tracking is per object and off until obj_track_changes(); a newly
+    // tracked object starts out dirty. Containers keep their tracked parents
+    // with obj_track_link/unlink (the map and array types in obj_helper do),
+    // so obj_note_change() marks the object and every tracked ancestor dirty,
+    // stamps them with a new generation and calls their subscribers, which
+    // may read the tree but must not release the objects they are told about.
+    // obj_add_attr/obj_remove_attr note changes on tracked objects themselves.
+    // A tree is tracked from one thread at a time. Generations only grow, so
+    // obj_change_generation(obj) > N asks "changed since generation N"
+    int obj_track_changes(Object* obj);     // 1 if obj was not tracked before
+    int obj_track_link(Object* parent, Object* child);  // no-op unless parent is tracked; tracks child
+    void obj_track_unlink(Object* parent, Object* child);
+    uint64_t obj_note_change(Object* obj);  // the change's generation, 0 if obj is not tracked
+    uint64_t obj_change_generation(Object* obj);    // 0 if obj is not tracked
+    uint64_t obj_current_change_generation();
+    int obj_is_dirty(Object* obj);
+    void obj_clear_dirty(Object* obj);
+    // tracks obj if needed; returns an id for obj_unsubscribe
+    size_t obj_subscribe(Object* obj, Obj_Change_Callback callback, void* context);
+    void obj_unsubscribe(Object* obj, size_t subscription);
+
     Object* obj_get_type(Object* obj);
     void obj_set_type(Object* obj, Object* type);
 
     Object_Key obj_attr_key_hash(Object* obj);
     Object_Key obj_attr_hash_string(const char32_t* str);
+    // for keys kept around without an attribute using them, e.g. in a global;
+    // the text's entry is never reclaimed
+    Object_Key obj_attr_hash_string_pinned(const char32_t* str);
+    // frees the interned strings nobody looked up since the previous sweep and
+    // returns how many. Attributes store only the key, and interning a freed
+    // text again yields its old key unless a different text with the same
+    // 63-bit hash was interned in between. Pinned strings and object keys are
+    // never freed. Safe from any thread, e.g. once per frame or on a timer
+    size_t obj_sweep_interned_keys();
+    Obj_Intern_Stats obj_get_intern_stats();
 
     Closure_Data* obj_query_method(Object* obj, Object_Key key);
 
@@ -93,10 +225,17 @@ extern "C" {
     Object_Attr_Iterator obj_attr_iter_end(Object* obj);
     Object_Attr_Iterator obj_attr_iter_next(Object_Attr_Iterator iter);
     int obj_attr_iter_equal(Object_Attr_Iterator iter1, Object_Attr_Iterator iter2);
+    Object_Key obj_attr_iter_key(Object_Attr_Iterator iter);
+    Object* obj_attr_iter_value(Object_Attr_Iterator iter);
 
     Object * obj_get_char32_string_type();
     Object* obj_create_char32_string(const char32_t* str);
     char* obj_str32_to_utf8(const char32_t* u32str);
+    // hashes and interns like the char32 string with the same content
+    Object* obj_get_compact_string_type();
+    Object* obj_create_compact_string(const char32_t* str);
+    char32_t obj_compact_string_at(const Obj_Compact_String* str, size_t index);
+    char* obj_compact_string_to_utf8(const Obj_Compact_String* str);
 
     void obj_debug_set_allocator(void *(*allocate)(size_t size), void (*deallocate)(void*));
     void obj_debug_add_tag(Object* obj, const char32_t* tag);